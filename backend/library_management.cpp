@@ -7,457 +7,4578 @@
 #include <sstream>
 #include <iomanip>
 #include <limits>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <string_view>
+#include <cstring>
+#include <cstddef>
+#include <unordered_map>
+#include <map>
+#include <memory>
+#include <array>
+#include <tuple>
+#include <variant>
+#include <queue>
+#include <functional>
+#include <charconv>
+#include <filesystem>
 
 #include "httplib.h"
 #include "json.hpp"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <intrin.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 using namespace std;
 
 
-using json = nlohmann::json;
+using json = nlohmann::json;
+
+
+// Dense book number: a book's position in the catalog, which only grows
+using BookId = uint32_t;
+
+// Append-only text storage. Strings are copied into large chunks and handed
+// back as views; chunks are never reallocated, so views stay valid for the
+// arena's lifetime and can key hash maps directly.
+class StringArena {
+    struct Chunk {
+        unique_ptr<char[]> data;
+        size_t used;
+    };
+    vector<Chunk> chunks;
+    size_t capacity = 0;  // Size of the last chunk
+    size_t total = 0;
+    static constexpr size_t kChunkSize = 1 << 20;
+
+public:
+    string_view add(string_view value) {
+        if (value.empty()) return string_view();
+        if (chunks.empty() || capacity - chunks.back().used < value.size()) {
+            capacity = max(kChunkSize, value.size());
+            chunks.push_back(Chunk{unique_ptr<char[]>(new char[capacity]), 0});
+        }
+        Chunk& chunk = chunks.back();
+        char* dest = chunk.data.get() + chunk.used;
+        memcpy(dest, value.data(), value.size());
+        chunk.used += value.size();
+        total += value.size();
+        return string_view(dest, value.size());
+    }
+
+    size_t bytes() const { return total; }
+    size_t chunkCount() const { return chunks.size(); }
+
+    // The used bytes of one chunk: the strings added to it, back to back
+    string_view chunk(size_t index) const { return string_view(chunks[index].data.get(), chunks[index].used); }
+};
+
+// Interned strings: each distinct value is stored once and referred to by
+// a small integer code, so columns hold codes and filters compare ints.
+using Symbol = uint32_t;
+
+class SymbolTable {
+    StringArena text;
+    vector<string_view> values;
+    unordered_map<string_view, Symbol> codes;
+
+public:
+    static constexpr Symbol kMissing = numeric_limits<Symbol>::max();
+
+    Symbol intern(string_view value) {
+        auto it = codes.find(value);
+        if (it != codes.end()) return it->second;
+        Symbol code = static_cast<Symbol>(values.size());
+        values.push_back(text.add(value));
+        codes.emplace(values.back(), code);
+        return code;
+    }
+
+    Symbol find(string_view value) const {
+        auto it = codes.find(value);
+        return it == codes.end() ? kMissing : it->second;
+    }
+
+    string_view get(Symbol code) const { return values[code]; }
+    size_t size() const { return values.size(); }
+};
+
+// Item types beyond plain books. Each carries one type-specific field; a
+// book has none (monostate). ItemType values match the variant indexes.
+struct DvdInfo {
+    int32_t runtimeMinutes = 0;
+};
+
+struct PeriodicalInfo {
+    int32_t issue = 0;
+};
+
+struct EBookInfo {
+    string format; // EPUB, PDF, ...
+};
+
+using ItemDetails = variant<monostate, DvdInfo, PeriodicalInfo, EBookInfo>;
+enum class ItemType : uint8_t { Book, Dvd, Periodical, EBook };
+
+// Per-type behaviour, resolved at compile time. name is the type's tag in
+// data files and JSON; field and label name its extra field.
+template <typename Info> struct ItemTraits;
+
+template <> struct ItemTraits<monostate> {
+    static constexpr const char* name = "book";
+};
+
+template <> struct ItemTraits<DvdInfo> {
+    static constexpr const char* name = "dvd";
+    static constexpr const char* field = "runtimeMinutes";
+    static constexpr const char* label = "Runtime (minutes)";
+    static int32_t value(const DvdInfo& info) { return info.runtimeMinutes; }
+    static bool parse(string_view text, DvdInfo& info) {
+        return from_chars(text.data(), text.data() + text.size(), info.runtimeMinutes).ec == errc();
+    }
+};
+
+template <> struct ItemTraits<PeriodicalInfo> {
+    static constexpr const char* name = "periodical";
+    static constexpr const char* field = "issue";
+    static constexpr const char* label = "Issue";
+    static int32_t value(const PeriodicalInfo& info) { return info.issue; }
+    static bool parse(string_view text, PeriodicalInfo& info) {
+        return from_chars(text.data(), text.data() + text.size(), info.issue).ec == errc();
+    }
+};
+
+template <> struct ItemTraits<EBookInfo> {
+    static constexpr const char* name = "ebook";
+    static constexpr const char* field = "format";
+    static constexpr const char* label = "Format";
+    static const string& value(const EBookInfo& info) { return info.format; }
+    static bool parse(string_view text, EBookInfo& info) {
+        info.format = string(text);
+        return true;
+    }
+};
+
+// Build the details for a type tag and its field text; false for an
+// unknown tag or a malformed field
+template <size_t I = 1>
+static bool parseItemDetails(string_view type, string_view field, ItemDetails& details) {
+    if constexpr (I < variant_size_v<ItemDetails>) {
+        using Info = variant_alternative_t<I, ItemDetails>;
+        if (type != ItemTraits<Info>::name) return parseItemDetails<I + 1>(type, field, details);
+        Info info;
+        if (!ItemTraits<Info>::parse(field, info)) return false;
+        details = move(info);
+        return true;
+    } else {
+        return false;
+    }
+}
+
+static const char* itemTypeName(ItemType type) {
+    static const char* const names[] = {ItemTraits<monostate>::name, ItemTraits<DvdInfo>::name,
+                                        ItemTraits<PeriodicalInfo>::name, ItemTraits<EBookInfo>::name};
+    return names[static_cast<size_t>(type)];
+}
+
+static bool parseItemType(string_view name, ItemType& type) {
+    for (uint8_t i = 0; i < variant_size_v<ItemDetails>; ++i) {
+        if (name == itemTypeName(static_cast<ItemType>(i))) {
+            type = static_cast<ItemType>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// The type-specific field as stored in data files; empty for a book
+static string itemDetailText(const ItemDetails& details) {
+    return visit([](const auto& info) -> string {
+        using Info = decay_t<decltype(info)>;
+        if constexpr (is_same_v<Info, monostate>) {
+            return string();
+        } else if constexpr (is_same_v<Info, EBookInfo>) {
+            return ItemTraits<Info>::value(info);
+        } else {
+            return to_string(ItemTraits<Info>::value(info));
+        }
+    }, details);
+}
+
+// One item's fields, as parsed from disk or captured for a snapshot
+struct BookRecord {
+    string title;
+    string author;
+    string isbn;
+    string genre;
+    int publicationYear = 0;
+    bool available = true;
+    ItemDetails details; // Plain book unless set
+};
+
+// A book's fields as views, for adding without copying the text first
+struct BookFields {
+    string_view title;
+    string_view author;
+    string_view isbn;
+    string_view genre;
+    int publicationYear = 0;
+    bool available = true;
+    ItemDetails details;
+};
+
+static inline int popcount64(uint64_t word) {
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(word));
+#else
+    return __builtin_popcountll(word);
+#endif
+}
+
+// Index of the lowest set bit; word must be non-zero
+static inline int lowestBit64(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+// Dense bitset over book ids. Alongside the words it keeps a Fenwick tree
+// of per-block (512 bit) counts, so count() is O(1) and rank/select stay
+// O(log n) while individual bits still flip cheaply on every checkout.
+class Bitset {
+    vector<uint64_t> words;
+    vector<uint32_t> tree; // Fenwick tree over blocks, 1-based; tree[0] unused
+    size_t bits = 0;
+    size_t ones = 0;
+    static constexpr size_t kBlockBits = 512;
+    static constexpr size_t kBlockWords = kBlockBits / 64;
+
+    static size_t lowBit(size_t i) { return i & (~i + 1); }
+
+    void addToBlock(size_t block, int64_t delta) {
+        for (size_t i = block + 1; i < tree.size(); i += lowBit(i)) {
+            tree[i] = static_cast<uint32_t>(tree[i] + delta);
+        }
+    }
+
+    // Set bits in blocks [0, block)
+    size_t blockPrefix(size_t block) const {
+        size_t sum = 0;
+        for (size_t i = block; i > 0; i -= lowBit(i)) sum += tree[i];
+        return sum;
+    }
+
+public:
+    Bitset() : tree(1) {}
+
+    void reserve(size_t n) {
+        words.reserve((n + 63) / 64);
+        tree.reserve(n / kBlockBits + 2);
+    }
+
+    void push_back(bool value) {
+        if (bits % 64 == 0) words.push_back(0);
+        if (bits % kBlockBits == 0) {
+            // The new node covers blocks (i - lowBit(i), i], all but the
+            // last of which already exist
+            size_t i = tree.size();
+            tree.push_back(static_cast<uint32_t>(blockPrefix(i - 1) - blockPrefix(i - lowBit(i))));
+        }
+        ++bits;
+        if (value) set(bits - 1, true);
+    }
+
+    // Grow with clear bits until the set holds n bits
+    void resize(size_t n) {
+        while (bits < n) push_back(false);
+    }
+
+    bool test(size_t i) const { return (words[i / 64] >> (i % 64)) & 1; }
+
+    void set(size_t i, bool value) {
+        uint64_t mask = uint64_t(1) << (i % 64);
+        uint64_t& word = words[i / 64];
+        if (((word & mask) != 0) == value) return;
+        word ^= mask;
+        if (value) ++ones; else --ones;
+        addToBlock(i / kBlockBits, value ? 1 : -1);
+    }
+
+    size_t size() const { return bits; }
+    size_t count() const { return ones; }
+    const vector<uint64_t>& getWords() const { return words; }
+
+    // Set bits before position i
+    size_t rank(size_t i) const {
+        size_t block = i / kBlockBits;
+        size_t result = blockPrefix(block);
+        size_t word = block * kBlockWords;
+        for (; word < i / 64; ++word) result += popcount64(words[word]);
+        if (i % 64) result += popcount64(words[word] & ((uint64_t(1) << (i % 64)) - 1));
+        return result;
+    }
+
+    // Position of the set bit with rank k, or size() if k >= count()
+    size_t select(size_t k) const {
+        if (k >= ones) return bits;
+        size_t block = 0;
+        size_t step = 1;
+        while (step * 2 < tree.size()) step *= 2;
+        for (; step > 0; step /= 2) {
+            if (block + step < tree.size() && tree[block + step] <= k) {
+                block += step;
+                k -= tree[block];
+            }
+        }
+        for (size_t word = block * kBlockWords;; ++word) {
+            uint64_t w = words[word];
+            size_t c = popcount64(w);
+            if (k < c) {
+                for (; k > 0; --k) w &= w - 1;
+                return word * 64 + lowestBit64(w);
+            }
+            k -= c;
+        }
+    }
+
+    // First set bit at or after i, or size()
+    size_t nextSet(size_t i) const {
+        if (i >= bits) return bits;
+        size_t word = i / 64;
+        uint64_t w = words[word] & (~uint64_t(0) << (i % 64));
+        while (w == 0) {
+            if (++word == words.size()) return bits;
+            w = words[word];
+        }
+        return word * 64 + lowestBit64(w);
+    }
+
+    // Bits set in both, a word at a time
+    static size_t countAnd(const Bitset& a, const Bitset& b) {
+        size_t n = min(a.words.size(), b.words.size());
+        size_t result = 0;
+        for (size_t i = 0; i < n; ++i) result += popcount64(a.words[i] & b.words[i]);
+        return result;
+    }
+
+    // Call f(position) for each bit set in both, in order; stop when f
+    // returns false
+    template <typename Visit>
+    static void forEachAnd(const Bitset& a, const Bitset& b, Visit f) {
+        size_t n = min(a.words.size(), b.words.size());
+        for (size_t i = 0; i < n; ++i) {
+            for (uint64_t w = a.words[i] & b.words[i]; w != 0; w &= w - 1) {
+                if (!f(i * 64 + lowestBit64(w))) return;
+            }
+        }
+    }
+};
+
+// Search text is compared in folded form: ASCII lowercased, and the
+// accented Latin letters of U+00C0..U+017F reduced to their base letters
+// (é -> e, Ł -> l, ß -> ss). Anything else passes through unchanged.
+// The catalog folds its text once on insert; only queries fold per request.
+static void appendFolded(string& out, string_view text) {
+    // Base letters for U+00C0..U+017F; '-' keeps the character, '?' is a
+    // two-letter folding handled below
+    static const char kLatinBase[] =
+        "aaaaaa?ceeeeiiiidnooooo-ouuuuy??"
+        "aaaaaa?ceeeeiiiidnooooo-ouuuuy?y"
+        "aaaaaaccccccccddddeeeeeeeeeegggg"
+        "gggghhhhiiiiiiiiii??jjkkklllllll"
+        "lllnnnnnnnnnoooooo??rrrrrrssssss"
+        "ssttttttuuuuuuuuuuuuwwyyyzzzzzzs";
+    out.reserve(out.size() + text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c < 0x80) {
+            out += static_cast<char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+            continue;
+        }
+        unsigned char next = i + 1 < text.size() ? static_cast<unsigned char>(text[i + 1]) : 0;
+        if (c < 0xC3 || c > 0xC5 || (next & 0xC0) != 0x80) {
+            out += static_cast<char>(c);
+            continue;
+        }
+        unsigned cp = (c & 0x1Fu) << 6 | (next & 0x3Fu);
+        char base = kLatinBase[cp - 0xC0];
+        if (base == '-') {
+            out.append(text.data() + i, 2);
+        } else if (base != '?') {
+            out += base;
+        } else if (cp == 0xC6 || cp == 0xE6) {
+            out += "ae";
+        } else if (cp == 0xDE || cp == 0xFE) {
+            out += "th";
+        } else if (cp == 0xDF) {
+            out += "ss";
+        } else if (cp == 0x132 || cp == 0x133) {
+            out += "ij";
+        } else {
+            out += "oe"; // U+0152, U+0153
+        }
+        ++i;
+    }
+}
+
+static string foldText(string_view text) {
+    string folded;
+    appendFolded(folded, text);
+    return folded;
+}
+
+// Substring search kernels. Each returns the first position >= from at
+// which pattern (non-empty) occurs in text, or text.size(). The vector
+// versions compare the pattern's first and last bytes against a whole
+// register of candidate positions at once and only memcmp the middle of
+// positions where both match. Single bytes go straight to memchr, which
+// the C library already vectorizes.
+using FindKernel = size_t (*)(string_view text, size_t from, string_view pattern);
+
+static size_t findScalar(string_view text, size_t from, string_view pattern) {
+    size_t pos = text.find(pattern, from);
+    return pos == string_view::npos ? text.size() : pos;
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LIBRARY_X86_KERNELS 1
+
+#if defined(__GNUC__)
+#define LIBRARY_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define LIBRARY_TARGET_AVX2
+#endif
+
+// SSE2 is part of x86-64, so this needs no runtime check
+static size_t findSse2(string_view text, size_t from, string_view pattern) {
+    const char* data = text.data();
+    size_t k = pattern.size();
+    if (k == 1) return findScalar(text, from, pattern);
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[k - 1]);
+    size_t i = from;
+    for (; i + k - 1 + 16 <= text.size(); i += 16) {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + k - 1));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast))));
+        for (; mask != 0; mask &= mask - 1) {
+            size_t pos = i + lowestBit64(mask);
+            if (k <= 2 || memcmp(data + pos + 1, pattern.data() + 1, k - 2) == 0) return pos;
+        }
+    }
+    return findScalar(text, i, pattern);
+}
+
+LIBRARY_TARGET_AVX2
+static size_t findAvx2(string_view text, size_t from, string_view pattern) {
+    const char* data = text.data();
+    size_t k = pattern.size();
+    if (k == 1) return findScalar(text, from, pattern);
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[k - 1]);
+    size_t i = from;
+    for (; i + k - 1 + 32 <= text.size(); i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + k - 1));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast))));
+        for (; mask != 0; mask &= mask - 1) {
+            size_t pos = i + lowestBit64(mask);
+            if (k <= 2 || memcmp(data + pos + 1, pattern.data() + 1, k - 2) == 0) return pos;
+        }
+    }
+    return findSse2(text, i, pattern);
+}
+
+static bool cpuHasAvx2() {
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5));
+#endif
+}
+#endif
+
+struct FindKernelInfo {
+    const char* name;
+    FindKernel find;
+};
+
+// Kernels this CPU can run, fastest first
+static vector<FindKernelInfo> availableFindKernels() {
+    vector<FindKernelInfo> kernels;
+#ifdef LIBRARY_X86_KERNELS
+    if (cpuHasAvx2()) kernels.push_back({"avx2", findAvx2});
+    kernels.push_back({"sse2", findSse2});
+#endif
+    kernels.push_back({"scalar", findScalar});
+    return kernels;
+}
+
+// Picked once at startup
+static const FindKernel findKernel = availableFindKernels().front().find;
+
+// Columnar catalog storage. Each field lives in its own contiguous column
+// indexed by BookId, so full-catalog scans stream through memory instead
+// of chasing one heap object per book. The ISBN doubles as the book's
+// identity; nothing else stores it. Title and ISBN text lives in one
+// arena, or stays in the mapping of the binary snapshot it was loaded
+// from; genre and author fields repeat heavily and are dictionary-encoded.
+// Searches run over a folded shadow copy of the title, author and genre
+// text, computed as each row or distinct value is first added.
+class Catalog {
+    StringArena text;
+    vector<string_view> titles;
+    StringArena foldedText;         // Folded titles only, back to back in id order
+    vector<BookId> titleChunkStart; // First book whose folded title is in each chunk
+    vector<string_view> foldedTitles;
+    StringArena foldedValueText;
+    vector<string_view> foldedAuthorValues; // By author code
+    vector<string_view> foldedGenreValues;  // By genre code
+    vector<Symbol> authors; // Code of the whole author field, "A; B" included
+    vector<string_view> isbns;
+    vector<Symbol> genres;
+    vector<int32_t> years;
+    Bitset available;
+    SymbolTable authorValues;
+    SymbolTable genreValues;
+    // Item type per id, and the row of its details in that type's table.
+    // Books, the common case, have no row.
+    vector<ItemType> types;
+    vector<uint32_t> detailRows;
+    tuple<vector<DvdInfo>, vector<PeriodicalInfo>, vector<EBookInfo>> detailTables;
+
+    string foldScratch; // Reused so folding a title allocates nothing
+
+public:
+    // Copies the record's title and ISBN into the catalog's arena
+    BookId add(const BookRecord& record) {
+        return addViews(BookFields{text.add(record.title), record.author, text.add(record.isbn), record.genre,
+                                   record.publicationYear, record.available, record.details});
+    }
+
+    // Keeps title and ISBN as the given views, which must outlive the
+    // catalog (a mapped snapshot does). Author and genre are interned.
+    BookId addViews(const BookFields& record) {
+        BookId id = static_cast<BookId>(titles.size());
+        titles.push_back(record.title);
+        size_t chunks = foldedText.chunkCount();
+        foldScratch.clear();
+        appendFolded(foldScratch, record.title);
+        foldedTitles.push_back(foldedText.add(foldScratch));
+        if (foldedText.chunkCount() != chunks) titleChunkStart.push_back(id);
+        authors.push_back(authorValues.intern(record.author));
+        if (authors.back() == foldedAuthorValues.size()) {
+            foldedAuthorValues.push_back(foldedValueText.add(foldText(record.author)));
+        }
+        isbns.push_back(record.isbn);
+        genres.push_back(genreValues.intern(record.genre));
+        if (genres.back() == foldedGenreValues.size()) {
+            foldedGenreValues.push_back(foldedValueText.add(foldText(record.genre)));
+        }
+        years.push_back(record.publicationYear);
+        available.push_back(record.available);
+        types.push_back(static_cast<ItemType>(record.details.index()));
+        visit([this](const auto& info) {
+            using Info = decay_t<decltype(info)>;
+            if constexpr (is_same_v<Info, monostate>) {
+                detailRows.push_back(0);
+            } else {
+                auto& table = get<vector<Info>>(detailTables);
+                detailRows.push_back(static_cast<uint32_t>(table.size()));
+                table.push_back(info);
+            }
+        }, record.details);
+        return id;
+    }
+
+    void reserve(size_t count) {
+        titles.reserve(count);
+        foldedTitles.reserve(count);
+        authors.reserve(count);
+        isbns.reserve(count);
+        genres.reserve(count);
+        years.reserve(count);
+        available.reserve(count);
+        types.reserve(count);
+        detailRows.reserve(count);
+    }
+
+    size_t size() const { return titles.size(); }
+
+    string_view getTitle(BookId id) const { return titles[id]; }
+    string_view getFoldedTitle(BookId id) const { return foldedTitles[id]; }
+    string_view getFoldedAuthorValue(Symbol code) const { return foldedAuthorValues[code]; }
+    string_view getFoldedGenreValue(Symbol code) const { return foldedGenreValues[code]; }
+
+    // Books whose folded title contains pattern (already folded), found by
+    // running a kernel over each chunk rather than searching title by title
+    vector<BookId> findInTitles(string_view pattern, FindKernel find = findKernel) const {
+        vector<BookId> result;
+        if (pattern.empty()) {
+            result.resize(titles.size());
+            for (BookId id = 0; id < titles.size(); ++id) result[id] = id;
+            return result;
+        }
+        for (size_t chunk = 0; chunk < foldedText.chunkCount(); ++chunk) {
+            string_view data = foldedText.chunk(chunk);
+            BookId id = titleChunkStart[chunk];
+            for (size_t pos = find(data, 0, pattern); pos < data.size(); pos = find(data, pos, pattern)) {
+                // Every byte of a chunk belongs to some title
+                const char* match = data.data() + pos;
+                while (foldedTitles[id].empty() || foldedTitles[id].data() + foldedTitles[id].size() <= match) {
+                    ++id;
+                }
+                const char* titleEnd = foldedTitles[id].data() + foldedTitles[id].size();
+                if (match + pattern.size() <= titleEnd) {
+                    result.push_back(id);
+                    pos = titleEnd - data.data(); // One hit per title is enough
+                } else {
+                    ++pos; // Runs across into the next title
+                }
+            }
+        }
+        return result;
+    }
+    string_view getAuthor(BookId id) const { return authorValues.get(authors[id]); }
+    string_view getIsbn(BookId id) const { return isbns[id]; }
+    string_view getGenre(BookId id) const { return genreValues.get(genres[id]); }
+    Symbol getAuthorCode(BookId id) const { return authors[id]; }
+    Symbol getGenreCode(BookId id) const { return genres[id]; }
+    const SymbolTable& getAuthorValues() const { return authorValues; }
+    const SymbolTable& getGenreValues() const { return genreValues; }
+    int getPublicationYear(BookId id) const { return years[id]; }
+    bool isAvailable(BookId id) const { return available.test(id); }
+    void setAvailable(BookId id, bool status) { available.set(id, status); }
+    const Bitset& getAvailability() const { return available; }
+
+    ItemType getType(BookId id) const { return types[id]; }
+
+    // Call f with the item's details (monostate for a book). The switch
+    // picks the table; each branch calls f with its concrete type.
+    template <typename Visit>
+    decltype(auto) visitDetails(BookId id, Visit&& f) const {
+        switch (types[id]) {
+            case ItemType::Dvd: return f(get<vector<DvdInfo>>(detailTables)[detailRows[id]]);
+            case ItemType::Periodical: return f(get<vector<PeriodicalInfo>>(detailTables)[detailRows[id]]);
+            case ItemType::EBook: return f(get<vector<EBookInfo>>(detailTables)[detailRows[id]]);
+            default: return f(monostate());
+        }
+    }
+
+    // Views stay valid while the catalog lives: its text is append-only
+    BookFields getFields(BookId id) const {
+        BookFields fields{titles[id], getAuthor(id), isbns[id], getGenre(id), years[id], available.test(id), {}};
+        visitDetails(id, [&fields](const auto& info) { fields.details = info; });
+        return fields;
+    }
+};
+
+// Handle to one book in a Catalog. Cheap to copy; a default-constructed
+// handle means "no book".
+class Book {
+    Catalog* catalog = nullptr;
+    BookId id = 0;
+
+public:
+    Book() = default;
+    Book(Catalog* catalog, BookId id) : catalog(catalog), id(id) {}
+
+    explicit operator bool() const { return catalog != nullptr; }
+    bool operator==(const Book& other) const { return catalog == other.catalog && id == other.id; }
+
+    BookId getId() const { return id; }
+    string_view getTitle() const { return catalog->getTitle(id); }
+    string_view getAuthor() const { return catalog->getAuthor(id); }
+    string_view getIsbn() const { return catalog->getIsbn(id); }
+    string_view getGenre() const { return catalog->getGenre(id); }
+    int getPublicationYear() const { return catalog->getPublicationYear(id); }
+    bool isAvailable() const { return catalog->isAvailable(id); }
+    void setAvailable(bool status) const { catalog->setAvailable(id, status); }
+    ItemType getType() const { return catalog->getType(id); }
+
+    void displayDetails() const {
+        cout << "Title: " << getTitle() << "\n"
+             << "Author: " << getAuthor() << "\n"
+             << "ISBN: " << getIsbn() << "\n"
+             << "Genre: " << getGenre() << "\n"
+             << "Publication Year: " << getPublicationYear() << "\n";
+        catalog->visitDetails(id, [](const auto& info) {
+            using Info = decay_t<decltype(info)>;
+            if constexpr (!is_same_v<Info, monostate>) {
+                cout << "Type: " << ItemTraits<Info>::name << "\n"
+                     << ItemTraits<Info>::label << ": " << ItemTraits<Info>::value(info) << "\n";
+            }
+        });
+        cout << "Available: " << (isAvailable() ? "Yes" : "No") << "\n";
+    }
+};
+
+// Due dates are kept as whole days since the epoch (UTC)
+using Day = int32_t;
+static const int kLoanDays = 14;
+
+static Day toDay(time_t t) {
+    return static_cast<Day>(t >= 0 ? t / 86400 : (t - 86399) / 86400);
+}
+
+static time_t fromDay(Day day) { return static_cast<time_t>(day) * 86400; }
+
+static Day today() { return toDay(time(nullptr)); }
+
+static string formatDay(Day day) {
+    time_t t = fromDay(day);
+    tm date = *gmtime(&t);
+    ostringstream out;
+    out << put_time(&date, "%Y-%m-%d");
+    return out.str();
+}
+
+using LoanId = uint32_t;
+static const LoanId kNoLoan = numeric_limits<LoanId>::max();
+
+// User class
+// Text fields are views into the library's user arena, or into the
+// mapped snapshot the user was loaded from
+class User {
+    string_view userId;
+    string_view name;
+    string_view email;
+    // The user's loans, a list threaded through the LoanTable
+    LoanId firstLoan = kNoLoan;
+    LoanId lastLoan = kNoLoan;
+    size_t loanCount = 0;
+    friend class LoanTable;
+
+public:
+    User(string_view userId, string_view name, string_view email) : userId(userId), name(name), email(email) {}
+
+    string_view getUserId() const { return userId; }
+    string_view getName() const { return name; }
+    string_view getEmail() const { return email; }
+    size_t getLoanCount() const { return loanCount; }
+
+    void displayDetails() const {
+        cout << "User ID: " << userId << "\n"
+             << "Name: " << name << "\n"
+             << "Email: " << email << "\n"
+             << "Books Borrowed: " << loanCount << "\n";
+    }
+};
+
+// Active loans. Slots are recycled through a free list, each book points
+// at its loan, and each user's loans form a doubly linked list threaded
+// through the slots, so checkout, return and holder lookup are all O(1).
+class LoanTable {
+public:
+    struct Loan {
+        User* user; // Null while the slot is free
+        BookId book;
+        Day due;
+        LoanId prev;
+        LoanId next;
+        uint32_t serial; // Distinguishes successive loans in one slot
+    };
+
+private:
+    vector<Loan> loans;
+    vector<LoanId> freeSlots;
+    vector<LoanId> bookLoans; // BookId -> loan, or kNoLoan
+    size_t active = 0;
+    uint32_t nextSerial = 0;
+
+public:
+    LoanId checkout(User* user, BookId book, Day due) {
+        LoanId id;
+        if (!freeSlots.empty()) {
+            id = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            id = static_cast<LoanId>(loans.size());
+            loans.emplace_back();
+        }
+        loans[id] = Loan{user, book, due, user->lastLoan, kNoLoan, nextSerial++};
+        if (user->lastLoan != kNoLoan) {
+            loans[user->lastLoan].next = id;
+        } else {
+            user->firstLoan = id;
+        }
+        user->lastLoan = id;
+        ++user->loanCount;
+        if (bookLoans.size() <= book) bookLoans.resize(book + 1, kNoLoan);
+        bookLoans[book] = id;
+        ++active;
+        return id;
+    }
+
+    void checkin(LoanId id) {
+        Loan& loan = loans[id];
+        User* user = loan.user;
+        if (loan.prev != kNoLoan) {
+            loans[loan.prev].next = loan.next;
+        } else {
+            user->firstLoan = loan.next;
+        }
+        if (loan.next != kNoLoan) {
+            loans[loan.next].prev = loan.prev;
+        } else {
+            user->lastLoan = loan.prev;
+        }
+        --user->loanCount;
+        bookLoans[loan.book] = kNoLoan;
+        loan.user = nullptr;
+        freeSlots.push_back(id);
+        --active;
+    }
+
+    LoanId findByBook(BookId book) const {
+        return book < bookLoans.size() ? bookLoans[book] : kNoLoan;
+    }
+
+    const Loan& get(LoanId id) const { return loans[id]; }
+
+    // Whether this particular checkout is still outstanding
+    bool isActive(LoanId id, uint32_t serial) const {
+        return id < loans.size() && loans[id].user && loans[id].serial == serial;
+    }
+
+    // Call f(loanId, loan) for each of the user's loans, oldest first
+    template <typename Visit>
+    void forEachOfUser(const User* user, Visit f) const {
+        for (LoanId id = user->firstLoan; id != kNoLoan; id = loans[id].next) {
+            f(id, loans[id]);
+        }
+    }
+
+    size_t size() const { return active; }
+};
+
+// A loan as handed out to callers
+struct LoanInfo {
+    User* user;
+    Book book;
+    Day due;
+};
+
+// Timing wheel over due days. Loans due within the next kWheelDays wait in
+// the bucket for their day; later ones wait in a min-heap until the wheel
+// comes within reach of them. advance() only visits the buckets of days
+// that have passed, so its cost follows the loans actually expiring.
+// Returned loans are not removed; they are skipped by serial number when
+// their day comes.
+class OverdueScheduler {
+public:
+    struct Entry {
+        LoanId loan;
+        uint32_t serial;
+        Day due;
+    };
+
+private:
+    struct LaterDue {
+        bool operator()(const Entry& a, const Entry& b) const { return a.due > b.due; }
+    };
+
+    static constexpr Day kWheelDays = 256;
+    vector<vector<Entry>> buckets;
+    priority_queue<Entry, vector<Entry>, LaterDue> farFuture;
+    vector<Entry> overdue; // Overdue when last advanced; may since be returned
+    size_t compactedSize = 0; // overdue.size() after the last purge
+    vector<Entry> pending; // Overdue but not yet reported by advance()
+    Day cursor;            // Loans due before this day are overdue
+
+    void place(const Entry& entry) {
+        if (entry.due < cursor) {
+            overdue.push_back(entry);
+            pending.push_back(entry);
+        } else if (entry.due < cursor + kWheelDays) {
+            buckets[entry.due % kWheelDays].push_back(entry);
+        } else {
+            farFuture.push(entry);
+        }
+    }
+
+public:
+    explicit OverdueScheduler(Day start) : buckets(kWheelDays), cursor(start) {}
+
+    void schedule(const Entry& entry) { place(entry); }
+
+    // Expire every day before today. Returns the loans that became overdue
+    // since the last call; isActive(entry) filters out returned ones.
+    template <typename IsActive>
+    vector<Entry> advance(Day today, IsActive isActive) {
+        while (cursor < today) {
+            vector<Entry>& bucket = buckets[cursor % kWheelDays];
+            ++cursor;
+            for (const Entry& entry : bucket) place(entry);
+            bucket.clear();
+            while (!farFuture.empty() && farFuture.top().due < cursor + kWheelDays) {
+                Entry entry = farFuture.top();
+                farFuture.pop();
+                place(entry);
+            }
+        }
+        vector<Entry> fresh;
+        for (const Entry& entry : pending) {
+            if (isActive(entry)) fresh.push_back(entry);
+        }
+        pending.clear();
+        // Purge returned loans once the list has doubled, so the purge
+        // costs O(1) amortized per overdue loan
+        if (overdue.size() >= 2 * compactedSize + 64) {
+            overdue.erase(remove_if(overdue.begin(), overdue.end(), [&](const Entry& e) { return !isActive(e); }),
+                          overdue.end());
+            compactedSize = overdue.size();
+        }
+        return fresh;
+    }
+
+    // Loans found overdue so far, some of which may have been returned
+    const vector<Entry>& getOverdue() const { return overdue; }
+};
+
+// Typed arena. Objects are constructed in large contiguous blocks, never
+// move, and are all destroyed and freed together when the pool goes away,
+// so a load allocates a handful of blocks instead of one chunk per object.
+template <typename T>
+class ObjectPool {
+    struct alignas(T) Slot {
+        unsigned char bytes[sizeof(T)];
+    };
+    struct Block {
+        unique_ptr<Slot[]> slots;
+        size_t capacity;
+        size_t used;
+    };
+
+    vector<Block> blocks;
+    size_t count = 0;
+    size_t nextBlockSize = 64; // Doubles per block up to kMaxBlockSize
+    static constexpr size_t kMaxBlockSize = 16384;
+
+    void addBlock(size_t capacity) {
+        blocks.push_back(Block{unique_ptr<Slot[]>(new Slot[capacity]), capacity, 0});
+    }
+
+public:
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    ~ObjectPool() { clear(); }
+
+    // Make room for n more objects in one block
+    void reserve(size_t n) {
+        size_t spare = blocks.empty() ? 0 : blocks.back().capacity - blocks.back().used;
+        if (n > spare) addBlock(n);
+    }
+
+    template <typename... Args>
+    T* create(Args&&... args) {
+        if (blocks.empty() || blocks.back().used == blocks.back().capacity) {
+            addBlock(nextBlockSize);
+            nextBlockSize = min(nextBlockSize * 2, kMaxBlockSize);
+        }
+        Block& block = blocks.back();
+        T* object = new (&block.slots[block.used]) T(std::forward<Args>(args)...);
+        ++block.used;
+        ++count;
+        return object;
+    }
+
+    void clear() {
+        for (auto& block : blocks) {
+            for (size_t i = 0; i < block.used; ++i) {
+                reinterpret_cast<T*>(&block.slots[i])->~T();
+            }
+        }
+        blocks.clear();
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+};
+
+// How the mutation log groups records into one fsync
+struct GroupCommitPolicy {
+    size_t maxBatchRecords = 128;       // Flush as soon as this many records wait
+    chrono::microseconds maxWait{1000}; // Longest a record waits for company
+};
+
+// Group-commit counters, reported by /api/stats and at shutdown
+struct GroupCommitStats {
+    uint64_t batches = 0;
+    uint64_t records = 0;
+    size_t maxBatch = 0;
+    double totalFlushMs = 0; // write + fsync time summed over batches
+    double maxFlushMs = 0;
+};
+
+// Cut a file down to size bytes and make that durable
+static bool truncateFile(const string& path, long long size) {
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_WRONLY | _O_BINARY);
+    bool ok = fd >= 0 && _chsize_s(fd, size) == 0 && _commit(fd) == 0;
+    if (fd >= 0) _close(fd);
+#else
+    int fd = ::open(path.c_str(), O_WRONLY);
+    bool ok = fd >= 0 && ftruncate(fd, static_cast<off_t>(size)) == 0 && fsync(fd) == 0;
+    if (fd >= 0) ::close(fd);
+#endif
+    return ok;
+}
+
+// Append-only mutation log (write-ahead log)
+// Every change to the library is appended as one line "<seq>,<op>,<fields>",
+// so a checkout costs a few bytes instead of a rewrite of library_data.txt.
+// Ops: B = add book, U = add user, L = loan, R = return.
+//
+// Appends only queue the record. A flusher thread writes whatever has
+// queued up and makes it durable with one fsync per batch; callers block in
+// waitDurable() until their record's batch is on disk.
+//
+// If a batch cannot be written the log is cut back to its last durable
+// byte and fails: that batch, everything queued after it and every later
+// append report not durable until the process restarts.
+class MutationLog {
+    string path;
+    FILE* out = nullptr;
+    long long goodOffset = -1; // File size after the last durable batch; -1 until opened
+    size_t bytes = 0;   // Bytes appended since the last rotation; guarded by queueMutex
+    size_t records = 0; // Records appended since the last rotation; guarded by queueMutex
+
+    thread flusher;
+    mutable mutex queueMutex;
+    condition_variable queueCv;   // Wakes the flusher
+    condition_variable durableCv; // Wakes callers waiting for durability
+    string pending;               // Records queued for the next batch
+    size_t pendingRecords = 0;
+    uint64_t pendingSeq = 0;      // Newest queued sequence number
+    uint64_t durableSeq = 0;      // Newest sequence number known on disk
+    bool flushing = false;
+    bool rotating = false; // rotate() owns the file; the flusher waits
+    bool stopping = false;
+    bool failed = false;
+    GroupCommitPolicy policy;
+    GroupCommitStats stats;
+
+public:
+    explicit MutationLog(const string& path) : path(path) {
+        flusher = thread([this]() { flushLoop(); });
+    }
+
+    ~MutationLog() { close(); }
+
+    const string& getPath() const { return path; }
+    string getRotatedPath() const { return path + ".1"; }
+    size_t getBytes() const {
+        lock_guard<mutex> lock(queueMutex);
+        return bytes;
+    }
+
+    size_t getRecords() const {
+        lock_guard<mutex> lock(queueMutex);
+        return records;
+    }
+
+    void setPolicy(const GroupCommitPolicy& newPolicy) {
+        lock_guard<mutex> lock(queueMutex);
+        policy = newPolicy;
+    }
+
+    GroupCommitStats getStats() const {
+        lock_guard<mutex> lock(queueMutex);
+        return stats;
+    }
+
+    // Queue a record; sequence numbers must be appended in increasing order
+    void append(uint64_t seq, char op, const string& fields) {
+        string record = to_string(seq) + ',' + op + ',' + fields + '\n';
+
+        lock_guard<mutex> lock(queueMutex);
+        bytes += record.size();
+        ++records;
+        pending += record;
+        ++pendingRecords;
+        pendingSeq = seq;
+        queueCv.notify_one();
+    }
+
+    // Block until the record with this sequence number is on disk; false
+    // if it never will be
+    bool waitDurable(uint64_t seq) {
+        unique_lock<mutex> lock(queueMutex);
+        durableCv.wait(lock, [&]() { return durableSeq >= seq || failed || stopping; });
+        return durableSeq >= seq;
+    }
+
+    bool isFailed() const {
+        lock_guard<mutex> lock(queueMutex);
+        return failed;
+    }
+
+    // Sequence numbers up to seq came from disk and are already durable
+    void noteReplayed(uint64_t seq, size_t recordBytes) {
+        lock_guard<mutex> lock(queueMutex);
+        bytes += recordBytes;
+        ++records;
+        durableSeq = pendingSeq = seq;
+    }
+
+    // Move the current log aside so a snapshot can be written while new
+    // records go to a fresh file. The rotated file is only needed until
+    // that snapshot is on disk. Appends may go on meanwhile: whatever is
+    // still queued goes to the fresh file, so a snapshot captured after
+    // this returns covers every record in the rotated one.
+    void rotate() {
+        unique_lock<mutex> lock(queueMutex);
+        durableCv.wait(lock, [this]() { return !flushing; });
+        rotating = true;
+        bytes = pending.size();
+        records = pendingRecords;
+        lock.unlock();
+
+        if (out) {
+            fclose(out);
+            out = nullptr;
+        }
+        if (!appendToRotated()) {
+            rename(path.c_str(), getRotatedPath().c_str());
+        }
+
+        lock.lock();
+        rotating = false;
+        queueCv.notify_one();
+    }
+
+    void dropRotated() {
+        remove(getRotatedPath().c_str());
+    }
+
+    // Flush everything queued and stop the flusher
+    void close() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            if (stopping) return;
+            stopping = true;
+            queueCv.notify_one();
+        }
+        flusher.join();
+        if (out) {
+            fclose(out);
+            out = nullptr;
+        }
+        durableCv.notify_all();
+    }
+
+private:
+    // A rotated log is still there if the last snapshot failed; keep its
+    // records by appending the current log to it. The current log is only
+    // removed once the copy is on disk. If the copy fails the rotated log
+    // is cut back and both are kept: replay reads both, skipping by
+    // sequence number what the snapshot already covers. False if there
+    // was no rotated log.
+    bool appendToRotated() {
+        string rotatedPath = getRotatedPath();
+        FILE* combined = fopen(rotatedPath.c_str(), "rb");
+        if (!combined) return false;
+        fclose(combined);
+
+        FILE* current = fopen(path.c_str(), "rb");
+        if (!current) return true; // Nothing logged since
+        combined = fopen(rotatedPath.c_str(), "ab");
+        long long start = -1;
+        bool ok = combined && fseek(combined, 0, SEEK_END) == 0 && (start = ftell(combined)) >= 0;
+        vector<char> buffer(64 * 1024);
+        size_t read;
+        while (ok && (read = fread(buffer.data(), 1, buffer.size(), current)) > 0) {
+            ok = fwrite(buffer.data(), 1, read, combined) == read;
+        }
+        ok = ok && !ferror(current) && fflush(combined) == 0;
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(combined)) == 0;
+#else
+        ok = ok && fsync(fileno(combined)) == 0;
+#endif
+        fclose(current);
+        if (combined) ok = fclose(combined) == 0 && ok;
+        if (ok) {
+            remove(path.c_str());
+        } else {
+            cerr << "Error appending to the rotated mutation log; keeping both logs.\n";
+            if (start >= 0 && !truncateFile(rotatedPath, start)) cerr << "Error truncating rotated mutation log.\n";
+        }
+        return true;
+    }
+
+    void flushLoop() {
+        unique_lock<mutex> lock(queueMutex);
+        while (true) {
+            queueCv.wait(lock, [this]() { return !pending.empty() || stopping; });
+            if (pending.empty()) break; // Stopping with nothing left to write
+
+            // Give concurrent writers a moment to join this batch
+            queueCv.wait_for(lock, policy.maxWait, [this]() {
+                return pendingRecords >= policy.maxBatchRecords || stopping;
+            });
+            queueCv.wait(lock, [this]() { return !rotating; });
+
+            string batch;
+            batch.swap(pending);
+            size_t batchRecords = pendingRecords;
+            uint64_t batchSeq = pendingSeq;
+            pendingRecords = 0;
+            if (failed) {
+                durableCv.notify_all(); // Nothing more is written once failed
+                continue;
+            }
+            flushing = true;
+            lock.unlock();
+
+            auto start = chrono::steady_clock::now();
+            bool ok = writeBatch(batch);
+            double flushMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+            lock.lock();
+            flushing = false;
+            if (ok) {
+                durableSeq = batchSeq;
+            } else {
+                failed = true;
+            }
+            ++stats.batches;
+            stats.records += batchRecords;
+            stats.maxBatch = max(stats.maxBatch, batchRecords);
+            stats.totalFlushMs += flushMs;
+            stats.maxFlushMs = max(stats.maxFlushMs, flushMs);
+            durableCv.notify_all();
+        }
+    }
+
+    // Called by the flusher without queueMutex held
+    bool writeBatch(const string& batch) {
+        if (!out) {
+            out = fopen(path.c_str(), "ab");
+            if (!out || fseek(out, 0, SEEK_END) != 0 || (goodOffset = ftell(out)) < 0) {
+                cerr << "Error opening mutation log.\n";
+                if (out) fclose(out);
+                out = nullptr;
+                return false;
+            }
+        }
+        bool ok = fwrite(batch.data(), 1, batch.size(), out) == batch.size() && fflush(out) == 0;
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(out)) == 0;
+#else
+        ok = ok && fsync(fileno(out)) == 0;
+#endif
+        if (ok) {
+            goodOffset += static_cast<long long>(batch.size());
+            return true;
+        }
+        cerr << "Error writing mutation log; no further changes will be saved.\n";
+        truncateToGood();
+        return false;
+    }
+
+    // Drop whatever part of a failed batch reached the file, so replay
+    // never meets a torn record
+    void truncateToGood() {
+        fclose(out);
+        out = nullptr;
+        if (!truncateFile(path, goodOffset)) cerr << "Error truncating mutation log.\n";
+    }
+};
+
+enum class SnapshotFormat { Text, Binary };
+
+// When the background snapshot thread compacts the mutation log
+struct SnapshotPolicy {
+    size_t maxLogBytes = 4 * 1024 * 1024; // Log size that triggers a snapshot
+    size_t maxLogRecords = 10000;         // Record count that triggers a snapshot
+    chrono::seconds interval{300};        // Snapshot at least this often when dirty
+    chrono::milliseconds debounce{200};   // Quiet time that ends a burst of mutations
+    chrono::milliseconds maxDelay{2000};  // Longest a due snapshot waits for quiet
+    SnapshotFormat format = SnapshotFormat::Binary;
+};
+
+// Point-in-time copy of the library, written out by the snapshot thread.
+// Text is held as views into the library's append-only storage, so the
+// capture copies no strings.
+struct SnapshotImage {
+    struct UserRow {
+        string_view userId;
+        string_view name;
+        string_view email;
+        vector<pair<string_view, time_t>> loans; // ISBN and due date
+    };
+
+    uint64_t lsn = 0; // Sequence number of the last mutation included
+    vector<BookFields> books;
+    vector<UserRow> users;
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            close();
+            return false;
+        }
+        data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // The mapping keeps the file alive
+        if (addr == MAP_FAILED) return false;
+        data = static_cast<const char*>(addr);
+        size = static_cast<size_t>(st.st_size);
+#endif
+        if (!data) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data) munmap(const_cast<char*>(data), size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const char* getData() const { return data; }
+    size_t getSize() const { return size; }
+};
+
+// Zero-copy reader for one comma-separated record. A field may be wrapped
+// in double quotes, so titles can contain commas. Inside quotes a quote
+// starts every escape: "" is a literal quote, "n a line feed and "r a
+// carriage return, which keeps each record on one line. (Files written
+// before "n and "r existed never contain them: a quote followed by
+// anything but another quote or a comma was a syntax error.) Fields are
+// returned as views into the line; only quoted fields with escapes are
+// unescaped, into a scratch buffer that the next call reuses.
+class RecordReader {
+    string_view rest;
+    bool finished = false;
+    string scratch;
+
+public:
+    explicit RecordReader(string_view line) : rest(line) {}
+
+    bool next(string_view& field) {
+        if (finished) return false;
+        if (!rest.empty() && rest.front() == '"') {
+            return nextQuoted(field);
+        }
+        size_t comma = rest.find(',');
+        field = rest.substr(0, comma);
+        if (comma == string_view::npos) {
+            finished = true;
+        } else {
+            rest.remove_prefix(comma + 1);
+        }
+        return true;
+    }
+
+    template <typename T>
+    bool nextNumber(T& value) {
+        string_view field;
+        if (!next(field)) return false;
+        auto result = from_chars(field.data(), field.data() + field.size(), value);
+        return result.ec == errc() && result.ptr == field.data() + field.size();
+    }
+
+    // Everything after the fields read so far
+    string_view remainder() const { return finished ? string_view() : rest; }
+
+private:
+    bool nextQuoted(string_view& field) {
+        size_t pos = 1;
+        bool escaped = false;
+        while (true) {
+            size_t quote = rest.find('"', pos);
+            if (quote == string_view::npos) {
+                return false; // Unterminated quote
+            }
+            if (quote + 1 < rest.size() && (rest[quote + 1] == '"' || rest[quote + 1] == 'n' || rest[quote + 1] == 'r')) {
+                escaped = true;
+                pos = quote + 2;
+                continue;
+            }
+            field = rest.substr(1, quote - 1);
+            pos = quote + 1;
+            break;
+        }
+        if (escaped) {
+            scratch.clear();
+            for (size_t i = 0; i < field.size(); ++i) {
+                if (field[i] != '"') {
+                    scratch += field[i];
+                    continue;
+                }
+                char code = field[++i];
+                scratch += code == 'n' ? '\n' : code == 'r' ? '\r' : '"';
+            }
+            field = scratch;
+        }
+        if (pos >= rest.size()) {
+            finished = true;
+        } else if (rest[pos] == ',') {
+            rest.remove_prefix(pos + 1);
+        } else {
+            return false; // Text after the closing quote
+        }
+        return true;
+    }
+};
+
+// Append value as one field of a record, quoting it when needed
+static void appendField(string& out, string_view value) {
+    if (value.find_first_of(",\"\r\n") == string_view::npos) {
+        out.append(value);
+        return;
+    }
+    out += '"';
+    for (char c : value) {
+        if (c == '"') {
+            out += "\"\"";
+        } else if (c == '\n') {
+            out += "\"n";
+        } else if (c == '\r') {
+            out += "\"r";
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// Parse text that is one whole decimal number and nothing else
+template <typename T>
+static bool parseNumber(string_view text, T& value) {
+    auto result = from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == errc() && result.ptr == text.data() + text.size();
+}
+
+// Append value as a quoted JSON string. Used by the hot response loops,
+// which write straight into one buffer instead of building json objects.
+static void appendJsonString(string& out, string_view value) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    size_t plain = 0; // Start of the run not yet copied
+    for (size_t i = 0; i < value.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out.append(value.data() + plain, i - plain);
+        plain = i + 1;
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xf];
+        }
+    }
+    out.append(value.data() + plain, value.size() - plain);
+    out += '"';
+}
+
+// Split text into newline-aligned chunks, one per thread (the calling
+// thread included), and call parseLine(line, out) for every non-empty
+// line. Per-chunk results are concatenated in file order.
+template <typename Result, typename ParseLine>
+static vector<Result> parseLinesParallel(string_view text, size_t threads, ParseLine parseLine) {
+    const size_t minChunkBytes = 64 * 1024;
+    size_t chunkCount = max<size_t>(1, min(threads, text.size() / minChunkBytes));
+
+    vector<size_t> cuts{0};
+    for (size_t i = 1; i < chunkCount; ++i) {
+        size_t cut = text.find('\n', text.size() * i / chunkCount);
+        cut = cut == string_view::npos ? text.size() : cut + 1;
+        if (cut > cuts.back() && cut < text.size()) cuts.push_back(cut);
+    }
+    cuts.push_back(text.size());
+
+    vector<vector<Result>> parts(cuts.size() - 1);
+    auto parseChunk = [&](size_t chunk) {
+        string_view rest = text.substr(cuts[chunk], cuts[chunk + 1] - cuts[chunk]);
+        while (!rest.empty()) {
+            size_t eol = rest.find('\n');
+            string_view line = rest.substr(0, eol);
+            rest.remove_prefix(eol == string_view::npos ? rest.size() : eol + 1);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (!line.empty()) parseLine(line, parts[chunk]);
+        }
+    };
+
+    vector<thread> workers;
+    for (size_t chunk = 1; chunk < parts.size(); ++chunk) {
+        workers.emplace_back(parseChunk, chunk);
+    }
+    parseChunk(0);
+    for (auto& worker : workers) worker.join();
+    if (parts.size() == 1) return move(parts[0]);
+
+    size_t total = 0;
+    for (const auto& part : parts) total += part.size();
+    vector<Result> results;
+    results.reserve(total);
+    for (auto& part : parts) {
+        move(part.begin(), part.end(), back_inserter(results));
+    }
+    return results;
+}
+
+// Binary snapshot (library_data.<lsn>.bin), version 2. Each snapshot is a
+// new file named by its sequence number, so the one a running library
+// still has mapped is never replaced; older ones are removed once a newer
+// snapshot is on disk. (Earlier releases wrote library_data.bin, which is
+// still loaded when no numbered file exists.) All integers are native
+// little-endian. Layout:
+//   header
+//   loan columns:  int64 due[], uint32 user[], uint32 book[] (row indexes)
+//   book columns:  uint32 title[], author[], isbn[], genre[] (string refs),
+//                  int32 year[], uint8 available[]
+//   user columns:  uint32 userId[], name[], email[] (string refs)
+//   detail columns: uint32 book[] (row index), field[] (string ref),
+//                  uint8 type[] (ItemType), one row per non-book item
+//   string table:  uint32 length + bytes, one entry per string ref
+// Version 1 files end the header before detailCount and hold only books.
+// Each column starts on an 8-byte boundary. A string ref is the offset of
+// the length prefix within the string table.
+struct BinarySnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t lsn;
+    uint64_t bookCount;
+    uint64_t userCount;
+    uint64_t loanCount;
+    uint64_t loansOffset;
+    uint64_t booksOffset;
+    uint64_t usersOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint64_t detailCount;   // Version 2 onwards
+    uint64_t detailsOffset;
+};
+
+static const char kBinarySnapshotMagic[8] = {'L', 'I', 'B', 'S', 'N', 'A', 'P', '\0'};
+static const uint32_t kBinarySnapshotVersion = 2;
+static const size_t kBinarySnapshotV1HeaderSize = offsetof(BinarySnapshotHeader, detailCount);
+static const uint32_t kBinarySnapshotByteOrder = 0x01020304;
+
+static size_t alignTo8(size_t n) { return (n + 7) & ~size_t(7); }
+
+// Typed view of a mapped binary snapshot. Fields are served straight from
+// the mapping; nothing is parsed or copied up front.
+class BinarySnapshotView {
+    MappedFile file;
+    BinarySnapshotHeader header{};
+
+    template <typename T>
+    T column(uint64_t offset, size_t index) const {
+        T value;
+        memcpy(&value, file.getData() + offset + index * sizeof(T), sizeof(T));
+        return value;
+    }
+
+    string_view text(uint64_t columnOffset, size_t index) const {
+        uint32_t ref = column<uint32_t>(columnOffset, index);
+        const char* entry = file.getData() + header.stringsOffset + ref;
+        uint32_t length;
+        memcpy(&length, entry, sizeof(length));
+        return string_view(entry + sizeof(length), length);
+    }
+
+    bool stringRefsValid(uint64_t columnOffset, size_t count) const {
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t ref = column<uint32_t>(columnOffset, i);
+            if (uint64_t(ref) + sizeof(uint32_t) > header.stringsSize) return false;
+            uint32_t length;
+            memcpy(&length, file.getData() + header.stringsOffset + ref, sizeof(length));
+            if (uint64_t(ref) + sizeof(uint32_t) + length > header.stringsSize) return false;
+        }
+        return true;
+    }
+
+public:
+    bool open(const string& path) {
+        if (!file.open(path) || file.getSize() < kBinarySnapshotV1HeaderSize) return false;
+        memcpy(&header, file.getData(), kBinarySnapshotV1HeaderSize);
+        if (memcmp(header.magic, kBinarySnapshotMagic, sizeof(header.magic)) != 0 ||
+            header.version < 1 || header.version > kBinarySnapshotVersion ||
+            header.byteOrder != kBinarySnapshotByteOrder) {
+            return false;
+        }
+        if (header.version >= 2) {
+            if (file.getSize() < sizeof(header)) return false;
+            memcpy(&header, file.getData(), sizeof(header));
+        }
+
+        // Reject truncated or inconsistent files before handing out views.
+        // Counts are bounded by the bytes left before multiplying, so a
+        // corrupt header cannot wrap the arithmetic.
+        uint64_t size = file.getSize();
+        auto fits = [size](uint64_t offset, uint64_t count, uint64_t rowBytes) {
+            return offset <= size && count <= (size - offset) / rowBytes;
+        };
+        if (!fits(header.loansOffset, header.loanCount, 16) || !fits(header.booksOffset, header.bookCount, 21) ||
+            !fits(header.usersOffset, header.userCount, 12) || !fits(header.detailsOffset, header.detailCount, 9) ||
+            !fits(header.stringsOffset, header.stringsSize, 1)) {
+            return false;
+        }
+        for (size_t i = 0; i < header.detailCount; ++i) {
+            if (detailBook(i) >= header.bookCount || detailType(i) == ItemType::Book ||
+                detailType(i) > ItemType::EBook) {
+                return false;
+            }
+        }
+        if (!stringRefsValid(header.detailsOffset + header.detailCount * 4, header.detailCount)) return false;
+        for (size_t i = 0; i < header.loanCount; ++i) {
+            if (loanUser(i) >= header.userCount || loanBook(i) >= header.bookCount) return false;
+        }
+        for (int col = 0; col < 4; ++col) {
+            if (!stringRefsValid(header.booksOffset + col * header.bookCount * 4, header.bookCount)) return false;
+        }
+        for (int col = 0; col < 3; ++col) {
+            if (!stringRefsValid(header.usersOffset + col * header.userCount * 4, header.userCount)) return false;
+        }
+        return true;
+    }
+
+    void close() { file.close(); }
+
+    uint64_t getLsn() const { return header.lsn; }
+    size_t bookCount() const { return header.bookCount; }
+    size_t userCount() const { return header.userCount; }
+    size_t loanCount() const { return header.loanCount; }
+
+    string_view bookTitle(size_t i) const { return text(header.booksOffset, i); }
+    string_view bookAuthor(size_t i) const { return text(header.booksOffset + header.bookCount * 4, i); }
+    string_view bookIsbn(size_t i) const { return text(header.booksOffset + header.bookCount * 8, i); }
+    string_view bookGenre(size_t i) const { return text(header.booksOffset + header.bookCount * 12, i); }
+    int bookYear(size_t i) const { return column<int32_t>(header.booksOffset + header.bookCount * 16, i); }
+    bool bookAvailable(size_t i) const { return column<uint8_t>(header.booksOffset + header.bookCount * 20, i) != 0; }
+
+    string_view userId(size_t i) const { return text(header.usersOffset, i); }
+    string_view userName(size_t i) const { return text(header.usersOffset + header.userCount * 4, i); }
+    string_view userEmail(size_t i) const { return text(header.usersOffset + header.userCount * 8, i); }
+
+    time_t loanDue(size_t i) const { return static_cast<time_t>(column<int64_t>(header.loansOffset, i)); }
+    size_t loanUser(size_t i) const { return column<uint32_t>(header.loansOffset + header.loanCount * 8, i); }
+    size_t loanBook(size_t i) const { return column<uint32_t>(header.loansOffset + header.loanCount * 12, i); }
+
+    size_t detailCount() const { return header.detailCount; }
+    size_t detailBook(size_t i) const { return column<uint32_t>(header.detailsOffset, i); }
+    string_view detailField(size_t i) const { return text(header.detailsOffset + header.detailCount * 4, i); }
+    ItemType detailType(size_t i) const {
+        return static_cast<ItemType>(column<uint8_t>(header.detailsOffset + header.detailCount * 8, i));
+    }
+};
+
+// Replace dst with src in one step so readers never see a partial file
+static bool replaceFile(const string& src, const string& dst) {
+#ifdef _WIN32
+    return MoveFileExA(src.c_str(), dst.c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (rename(src.c_str(), dst.c_str()) != 0) return false;
+    // Make the rename itself durable
+    size_t slash = dst.find_last_of('/');
+    string dir = slash == string::npos ? "." : dst.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+    return true;
+#endif
+}
+
+// Write contents to a temp file, fsync it and rename it over path. A crash
+// leaves either the old file or the new one, never a torn mix.
+static bool writeFileAtomically(const string& path, const string& contents) {
+    string tmpPath = path + ".tmp";
+    FILE* out = fopen(tmpPath.c_str(), "wb");
+    if (!out) return false;
+    bool ok = fwrite(contents.data(), 1, contents.size(), out) == contents.size() && fflush(out) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(out)) == 0;
+#else
+    ok = ok && fsync(fileno(out)) == 0;
+#endif
+    ok = fclose(out) == 0 && ok;
+    if (!ok || !replaceFile(tmpPath, path)) {
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+using AuthorId = uint32_t;
+
+// Author entities and the many-to-many book/author mapping. A book's
+// author field may name several authors separated by ';'. Postings are
+// kept sorted by book id, which holds for free because ids only grow.
+// Lookups by name ignore case and accents: names that fold alike are
+// grouped, and a lookup merges the group's postings.
+class AuthorTable {
+    SymbolTable names;
+    vector<vector<BookId>> postings; // Author -> books
+    SymbolTable foldedNames;
+    vector<vector<AuthorId>> spellings; // Folded name -> authors
+
+public:
+    // Split "A; B" into trimmed, non-empty author names
+    static vector<string_view> splitNames(string_view field) {
+        vector<string_view> result;
+        size_t start = 0;
+        while (start <= field.size()) {
+            size_t end = field.find(';', start);
+            if (end == string_view::npos) end = field.size();
+            size_t first = field.find_first_not_of(" \t", start);
+            size_t last = field.find_last_not_of(" \t", end - 1);
+            if (first != string_view::npos && first < end && last != string_view::npos && last >= first) {
+                result.push_back(field.substr(first, last - first + 1));
+            }
+            start = end + 1;
+        }
+        return result;
+    }
+
+    // Register book id (the next one) with the authors in its author field.
+    // Ids arrive in order, so a repeated author already ends with this book.
+    void addBook(BookId book, string_view authorField) {
+        for (const auto& name : splitNames(authorField)) {
+            AuthorId author = names.intern(name);
+            if (author == postings.size()) {
+                postings.emplace_back();
+                Symbol folded = foldedNames.intern(foldText(name));
+                if (folded == spellings.size()) spellings.emplace_back();
+                spellings[folded].push_back(author);
+            }
+            if (!postings[author].empty() && postings[author].back() == book) continue;
+            postings[author].push_back(book);
+        }
+    }
+
+    // Books by every author whose name folds like name, ascending by id
+    vector<BookId> findBooks(string_view name) const {
+        Symbol folded = foldedNames.find(foldText(name));
+        if (folded == SymbolTable::kMissing) return {};
+        vector<BookId> result;
+        for (AuthorId author : spellings[folded]) {
+            size_t middle = result.size();
+            result.insert(result.end(), postings[author].begin(), postings[author].end());
+            inplace_merge(result.begin(), result.begin() + middle, result.end());
+        }
+        result.erase(unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    // Books written by every named author, ascending by id
+    vector<BookId> findBooksByAll(const vector<string_view>& authorNames) const {
+        vector<vector<BookId>> lists;
+        for (const auto& name : authorNames) {
+            lists.push_back(findBooks(name));
+            if (lists.back().empty()) return {};
+        }
+        if (lists.empty()) return {};
+
+        // Intersect starting from the shortest list
+        sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) { return a.size() < b.size(); });
+        vector<BookId> result = move(lists[0]);
+        for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+            vector<BookId> next;
+            set_intersection(result.begin(), result.end(), lists[i].begin(), lists[i].end(), back_inserter(next));
+            result.swap(next);
+        }
+        return result;
+    }
+
+    string_view getName(AuthorId author) const { return names.get(author); }
+    size_t getBookCount(AuthorId author) const { return postings[author].size(); }
+    size_t size() const { return names.size(); }
+};
+
+// Sorted list of book ids stored as varint-encoded gaps. Every
+// kSkipInterval postings a skip entry records the id reached and where the
+// bytes after it start, so a cursor can jump ahead without decoding.
+class PostingList {
+public:
+    struct Skip {
+        BookId id;
+        uint32_t offset;
+    };
+    static constexpr uint32_t kSkipInterval = 64;
+
+private:
+    string bytes;
+    vector<Skip> skips;
+    BookId last = 0;
+    uint32_t count = 0;
+
+public:
+    // Ids must arrive in ascending order; a repeat of the last id is ignored
+    void add(BookId id) {
+        if (count > 0 && id == last) return;
+        uint32_t gap = count > 0 ? id - last : id;
+        while (gap >= 0x80) {
+            bytes += static_cast<char>((gap & 0x7f) | 0x80);
+            gap >>= 7;
+        }
+        bytes += static_cast<char>(gap);
+        last = id;
+        if (++count % kSkipInterval == 0) {
+            skips.push_back(Skip{id, static_cast<uint32_t>(bytes.size())});
+        }
+    }
+
+    uint32_t size() const { return count; }
+    size_t byteSize() const { return bytes.size() + skips.size() * sizeof(Skip); }
+
+    class Cursor {
+        const PostingList* list;
+        size_t offset = 0;
+        uint32_t index = 0; // Postings consumed so far
+        BookId current = 0;
+        bool valid = false;
+
+    public:
+        explicit Cursor(const PostingList& list) : list(&list) { next(); }
+
+        bool isValid() const { return valid; }
+        BookId get() const { return current; }
+
+        void next() {
+            if (index == list->count) {
+                valid = false;
+                return;
+            }
+            uint32_t gap = 0;
+            int shift = 0;
+            unsigned char byte;
+            do {
+                byte = static_cast<unsigned char>(list->bytes[offset++]);
+                gap |= uint32_t(byte & 0x7f) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            current = index == 0 ? gap : current + gap;
+            ++index;
+            valid = true;
+        }
+
+        // Move to the first id >= target
+        void advanceTo(BookId target) {
+            if (!valid || current >= target) return;
+            // Jump to the last skip at or below target, if the target lies
+            // beyond the next one; otherwise decoding is cheaper
+            const auto& skips = list->skips;
+            auto ahead = skips.begin() + index / kSkipInterval;
+            if (ahead != skips.end() && ahead->id <= target) {
+                auto it = upper_bound(ahead, skips.end(), target,
+                                      [](BookId value, const Skip& skip) { return value < skip.id; }) - 1;
+                current = it->id;
+                offset = it->offset;
+                index = static_cast<uint32_t>(it - skips.begin() + 1) * kSkipInterval;
+            }
+            while (valid && current < target) next();
+        }
+    };
+};
+
+// Ids present in every list. Walks the shortest list and advances cursors
+// through the others, so long lists are mostly skipped, not decoded.
+static vector<BookId> intersectPostings(vector<const PostingList*> lists) {
+    vector<BookId> result;
+    if (lists.empty()) return result;
+    sort(lists.begin(), lists.end(), [](auto a, auto b) { return a->size() < b->size(); });
+    vector<PostingList::Cursor> others;
+    for (size_t i = 1; i < lists.size(); ++i) others.emplace_back(*lists[i]);
+    for (PostingList::Cursor lead(*lists[0]); lead.isValid(); lead.next()) {
+        BookId id = lead.get();
+        bool inAll = true;
+        for (auto& cursor : others) {
+            cursor.advanceTo(id);
+            if (!cursor.isValid()) return result;
+            if (cursor.get() != id) {
+                inAll = false;
+                break;
+            }
+        }
+        if (inAll) result.push_back(id);
+    }
+    return result;
+}
+
+// Word index over title, author and genre. Text is split into runs of
+// letters and digits, ASCII letters lowercased; bytes of multi-byte UTF-8
+// characters count as letters. Books are indexed as they are inserted, in
+// id order, so posting lists only ever append.
+class TermIndex {
+    SymbolTable terms;
+    vector<PostingList> postings;
+    // Terms of each distinct author and genre value (by catalog code),
+    // tokenized the first time the value is seen
+    vector<vector<Symbol>> authorTerms;
+    vector<vector<Symbol>> genreTerms;
+
+    Symbol internTerm(string_view token) {
+        Symbol term = terms.intern(token);
+        if (term == postings.size()) postings.emplace_back();
+        return term;
+    }
+
+    void addInterned(BookId book, vector<vector<Symbol>>& cache, Symbol code, string_view folded) {
+        if (code == cache.size()) {
+            cache.emplace_back();
+            tokenize(folded, [&](string_view token) { cache.back().push_back(internTerm(token)); });
+        }
+        for (Symbol term : cache[code]) postings[term].add(book);
+    }
+
+public:
+    // Split folded text into terms: runs of ASCII letters and digits, with
+    // bytes of other UTF-8 characters counted as letters
+    template <typename Visit>
+    static void tokenize(string_view folded, Visit f) {
+        size_t start = 0;
+        for (size_t i = 0; i <= folded.size(); ++i) {
+            unsigned char c = i < folded.size() ? static_cast<unsigned char>(folded[i]) : ' ';
+            if (isalnum(c) || c >= 0x80) continue;
+            if (i > start) f(folded.substr(start, i - start));
+            start = i + 1;
+        }
+    }
+
+    // Index a newly inserted book
+    void addBook(const Catalog& catalog, BookId book) {
+        tokenize(catalog.getFoldedTitle(book), [&](string_view token) { postings[internTerm(token)].add(book); });
+        Symbol author = catalog.getAuthorCode(book);
+        addInterned(book, authorTerms, author, catalog.getFoldedAuthorValue(author));
+        Symbol genre = catalog.getGenreCode(book);
+        addInterned(book, genreTerms, genre, catalog.getFoldedGenreValue(genre));
+    }
+
+    // Books containing every term of the folded query (matchAll) or any of them
+    vector<BookId> find(string_view query, bool matchAll) const {
+        vector<const PostingList*> lists;
+        bool missing = false;
+        tokenize(query, [&](string_view token) {
+            Symbol term = terms.find(token);
+            if (term == SymbolTable::kMissing) {
+                missing = true;
+            } else if (find_if(lists.begin(), lists.end(), [&](auto l) { return l == &postings[term]; }) == lists.end()) {
+                lists.push_back(&postings[term]);
+            }
+        });
+        vector<BookId> result;
+        if (lists.empty() || (matchAll && missing)) return result;
+
+        if (matchAll) {
+            result = intersectPostings(lists);
+        } else {
+            for (const PostingList* list : lists) {
+                vector<BookId> merged;
+                merged.reserve(result.size() + list->size());
+                PostingList::Cursor cursor(*list);
+                size_t i = 0;
+                while (cursor.isValid() || i < result.size()) {
+                    if (!cursor.isValid() || (i < result.size() && result[i] < cursor.get())) {
+                        merged.push_back(result[i++]);
+                    } else {
+                        if (i < result.size() && result[i] == cursor.get()) ++i;
+                        merged.push_back(cursor.get());
+                        cursor.next();
+                    }
+                }
+                result.swap(merged);
+            }
+        }
+        return result;
+    }
+
+    size_t size() const { return terms.size(); }
+
+    size_t byteSize() const {
+        size_t total = 0;
+        for (const auto& list : postings) total += list.byteSize();
+        return total;
+    }
+};
+
+// Index of the three-byte substrings of each entry's text. A pattern can
+// only occur in entries that contain all of its trigrams, so intersecting
+// their lists yields candidates that the caller then verifies. Entries
+// must be added in ascending id order.
+class TrigramIndex {
+    unordered_map<uint32_t, PostingList> postings;
+
+    static uint32_t key(const char* p) {
+        return uint32_t(uint8_t(p[0])) << 16 | uint32_t(uint8_t(p[1])) << 8 | uint8_t(p[2]);
+    }
+
+public:
+    void add(uint32_t id, string_view text) {
+        for (size_t i = 0; i + 3 <= text.size(); ++i) {
+            postings[key(text.data() + i)].add(id); // Repeats within one entry are dropped
+        }
+    }
+
+    // Entries that may contain pattern, which must be at least 3 bytes
+    vector<uint32_t> candidates(string_view pattern) const {
+        vector<const PostingList*> lists;
+        for (size_t i = 0; i + 3 <= pattern.size(); ++i) {
+            auto it = postings.find(key(pattern.data() + i));
+            if (it == postings.end()) return {};
+            if (find(lists.begin(), lists.end(), &it->second) == lists.end()) lists.push_back(&it->second);
+        }
+        return intersectPostings(lists);
+    }
+
+    // Entries that may contain pattern with up to maxEdits edits. Cut into
+    // maxEdits + 1 pieces, the pattern keeps at least one piece intact in
+    // any such match, so the union of the pieces' candidates covers them
+    // all. Returns false when the pieces are too short to look up.
+    bool candidatesWithin(string_view pattern, size_t maxEdits, vector<uint32_t>& result) const {
+        size_t pieces = maxEdits + 1;
+        if (pattern.size() / pieces < 3) return false;
+        result.clear();
+        for (size_t i = 0; i < pieces; ++i) {
+            size_t begin = i * pattern.size() / pieces, end = (i + 1) * pattern.size() / pieces;
+            vector<uint32_t> found = candidates(pattern.substr(begin, end - begin));
+            result.insert(result.end(), found.begin(), found.end());
+        }
+        sort(result.begin(), result.end());
+        result.erase(unique(result.begin(), result.end()), result.end());
+        return true;
+    }
+
+    size_t byteSize() const {
+        size_t total = 0;
+        for (const auto& entry : postings) total += entry.second.byteSize();
+        return total;
+    }
+};
+
+// Myers' bit-parallel approximate matching: the fewest edits that turn the
+// pattern into some substring of a text. The DP column for each text byte
+// is held as vertical +1/-1 delta bit vectors, so a step is a handful of
+// word operations instead of one cell update per pattern byte. Patterns
+// are capped at 64 bytes, one machine word; longer ones are truncated.
+class FuzzyPattern {
+    array<uint64_t, 256> match{}; // Per byte, the pattern positions holding it
+    uint64_t last;
+    size_t length;
+
+public:
+    static constexpr size_t kMaxLength = 64;
+
+    explicit FuzzyPattern(string_view pattern) : length(min(pattern.size(), kMaxLength)) {
+        for (size_t i = 0; i < length; ++i) match[static_cast<unsigned char>(pattern[i])] |= uint64_t(1) << i;
+        last = length ? uint64_t(1) << (length - 1) : 0;
+    }
+
+    // Edit distance from the pattern to its best match in text, or
+    // limit + 1 if that is more than limit
+    size_t distance(string_view text, size_t limit) const {
+        if (length == 0) return 0;
+        uint64_t plus = length == 64 ? ~uint64_t(0) : (uint64_t(1) << length) - 1, minus = 0;
+        size_t score = length, best = length;
+        for (unsigned char c : text) {
+            uint64_t eq = match[c];
+            uint64_t xv = eq | minus;
+            uint64_t xh = (((eq & plus) + plus) ^ plus) | eq;
+            uint64_t hPlus = minus | ~(xh | plus);
+            uint64_t hMinus = plus & xh;
+            score += (hPlus & last) != 0;
+            score -= (hMinus & last) != 0;
+            // The top DP row stays zero: a match may start anywhere
+            hPlus <<= 1;
+            hMinus <<= 1;
+            plus = hMinus | ~(xv | hPlus);
+            minus = hPlus & xv;
+            best = min(best, score);
+            if (best == 0) break;
+        }
+        return best <= limit ? best : limit + 1;
+    }
+};
+
+// Fuzzy edit budget scaled to the query: none for 1-2 bytes, one typo up
+// to 5 bytes, two beyond
+static const size_t kAutoEdits = SIZE_MAX;
+
+struct FuzzyMatch {
+    BookId id;
+    uint32_t distance;
+};
+
+// Immutable prefix dictionary behind autocomplete. Keys are sorted and
+// front-coded in blocks of kBlockKeys: each block opens with a whole key,
+// and every later key stores only the bytes it does not share with the
+// key before it. The keys starting with a prefix form one run of ranks;
+// a max-tree over the weights in rank order hands out that run's heaviest
+// keys best-first without visiting the rest of it.
+class SuggestIndex {
+public:
+    struct Key {
+        string_view text;
+        uint32_t ref; // The caller's id for what the key stands for
+        uint32_t weight;
+    };
+    struct Suggestion {
+        uint32_t ref;
+        uint32_t weight;
+    };
+
+private:
+    static constexpr size_t kBlockKeys = 16;
+    string data;                 // Front-coded keys
+    vector<uint32_t> blockStart; // Offset of each block in data
+    vector<uint32_t> refs;       // By rank
+    vector<uint32_t> weights;    // By rank
+    vector<uint32_t> best;       // Node -> heaviest rank below it; leaf of rank r is node size + r
+
+    static void putVarint(string& out, size_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    static size_t getVarint(const char*& p) {
+        size_t value = 0;
+        int shift = 0;
+        unsigned char byte;
+        do {
+            byte = static_cast<unsigned char>(*p++);
+            value |= size_t(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return value;
+    }
+
+    // Heavier first, then earlier
+    bool heavier(uint32_t a, uint32_t b) const {
+        return weights[a] != weights[b] ? weights[a] > weights[b] : a < b;
+    }
+
+    // Number of keys for which before(key) holds; they must all come first
+    template <typename Before>
+    size_t partitionPoint(Before before) const {
+        size_t lo = 0, hi = blockStart.size(); // Blocks whose first key is before
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            const char* p = data.data() + blockStart[mid];
+            getVarint(p); // Shared length, always 0
+            size_t length = getVarint(p);
+            if (before(string_view(p, length))) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo == 0) return 0;
+        // The boundary lies inside the last such block
+        size_t first = (lo - 1) * kBlockKeys, end = min(refs.size(), first + kBlockKeys);
+        const char* p = data.data() + blockStart[lo - 1];
+        string key;
+        for (size_t rank = first; rank < end; ++rank) {
+            key.resize(getVarint(p));
+            size_t length = getVarint(p);
+            key.append(p, length);
+            p += length;
+            if (rank > first && !before(key)) return rank;
+        }
+        return end;
+    }
+
+public:
+    // Equal keys merge: their weights add and the smallest ref is kept
+    explicit SuggestIndex(vector<Key> keys) {
+        sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) {
+            return a.text != b.text ? a.text < b.text : a.ref < b.ref;
+        });
+        string_view previous;
+        for (const Key& key : keys) {
+            if (!refs.empty() && key.text == previous) {
+                weights.back() += key.weight;
+                continue;
+            }
+            size_t shared = 0;
+            if (refs.size() % kBlockKeys == 0) {
+                blockStart.push_back(static_cast<uint32_t>(data.size()));
+            } else {
+                size_t limit = min(previous.size(), key.text.size());
+                while (shared < limit && previous[shared] == key.text[shared]) ++shared;
+            }
+            putVarint(data, shared);
+            putVarint(data, key.text.size() - shared);
+            data.append(key.text.data() + shared, key.text.size() - shared);
+            refs.push_back(key.ref);
+            weights.push_back(key.weight);
+            previous = key.text;
+        }
+        data.shrink_to_fit();
+
+        size_t n = refs.size();
+        best.resize(2 * n);
+        for (size_t rank = 0; rank < n; ++rank) best[n + rank] = static_cast<uint32_t>(rank);
+        for (size_t node = n; node-- > 1;) {
+            best[node] = heavier(best[2 * node], best[2 * node + 1]) ? best[2 * node] : best[2 * node + 1];
+        }
+    }
+
+    // The k heaviest keys starting with prefix, heaviest first
+    vector<Suggestion> complete(string_view prefix, size_t k) const {
+        size_t n = refs.size();
+        size_t lo = partitionPoint([&](string_view key) { return key < prefix; });
+        size_t hi = partitionPoint([&](string_view key) { return key.substr(0, prefix.size()) <= prefix; });
+
+        // Best-first over the tree nodes that exactly cover ranks [lo, hi)
+        auto lighter = [this](uint32_t a, uint32_t b) { return heavier(best[b], best[a]); };
+        priority_queue<uint32_t, vector<uint32_t>, decltype(lighter)> queue(lighter);
+        for (size_t l = lo + n, r = hi + n; l < r; l /= 2, r /= 2) {
+            if (l & 1) queue.push(static_cast<uint32_t>(l++));
+            if (r & 1) queue.push(static_cast<uint32_t>(--r));
+        }
+        vector<Suggestion> result;
+        while (!queue.empty() && result.size() < k) {
+            uint32_t node = queue.top();
+            queue.pop();
+            if (node >= n) {
+                result.push_back({refs[node - n], weights[node - n]});
+            } else {
+                queue.push(2 * node);
+                queue.push(2 * node + 1);
+            }
+        }
+        return result;
+    }
+
+    size_t size() const { return refs.size(); }
+
+    size_t byteSize() const {
+        return data.size() + (blockStart.size() + refs.size() + weights.size() + best.size()) * sizeof(uint32_t);
+    }
+};
+
+// Substring of title, author or genre; whole words, all or any of them;
+// or, for Fuzzy, the title, author or genre with fewest edits
+enum class SearchMode { Substring, AllTerms, AnyTerm, Fuzzy };
+
+class Benchmarks;
+
+// Library class (Singleton)
+class Library {
+    friend class Benchmarks;
+
+    httplib::Server svr;  // Add this as a private member variable
+    bool serverRunning = false;
+    static Library* instance;
+    // The binary snapshot loaded at startup. Books and users loaded from
+    // it keep viewing its text, so it stays mapped for the library's
+    // lifetime, and later snapshots are written to new files beside it.
+    BinarySnapshotView snapshotFile;
+    string snapshotFilePath; // Empty unless snapshotFile is mapped
+    Catalog books;
+    ObjectPool<User> userPool; // Owns every User
+    StringArena userText;      // Text of users added after startup
+    vector<User*> users;
+    LoanTable loans;
+    OverdueScheduler overdue{today()};
+    MutationLog log{"library_data.log"};
+    uint64_t lastSeq = 0; // Sequence number of the newest applied mutation
+    // Hash indexes. Keys are views of the strings inside each User and of
+    // the catalog's text arena, which never moves.
+    // Every path that adds a book or user goes through insertBook/insertUser.
+    unordered_map<string_view, BookId> isbnIndex;
+    unordered_map<string_view, User*> userIdIndex;
+    unordered_map<string_view, User*> emailIndex;
+    vector<vector<BookId>> genreIndex; // Genre code -> postings in id order
+    vector<vector<BookId>> authorFieldIndex; // Author field code -> postings in id order
+    // Genre code -> membership bitmap, kept only for genres common enough
+    // that the bitmap is no larger than their postings. Empty otherwise.
+    vector<Bitset> genreBitmaps;
+    static constexpr size_t kDenseGenreBooks = 1024;
+    AuthorTable authors;
+    TermIndex termIndex;
+    // Substring search: trigrams of each folded title by book, and of each
+    // distinct folded author and genre value by code
+    TrigramIndex titleTrigrams;
+    TrigramIndex authorTrigrams;
+    TrigramIndex genreTrigrams;
+
+    // Guards books, users, lastSeq and log. Writers take it exclusively;
+    // HTTP handlers and the snapshot thread take it shared.
+    mutable shared_mutex dataMutex;
+
+    // Background snapshot thread
+    thread snapshotThread;
+    mutex snapshotMutex;
+    condition_variable snapshotCv;
+    SnapshotPolicy snapshotPolicy;
+    bool snapshotRequested = false;
+    bool snapshotStopping = false;
+    bool snapshotPolicyChanged = false; // Restart the interval wait under the new policy
+    bool dirty = false; // Mutations since the last snapshot capture
+    chrono::steady_clock::time_point lastMutation;
+    mutex snapshotWriteMutex; // Serializes snapshot writers
+
+    // Background overdue job: advances the due-date wheel and hands each
+    // batch of newly overdue loans to overdueHandler
+    thread overdueThread;
+    mutex overdueMutex;
+    condition_variable overdueCv;
+    bool overdueStopping = false;
+    bool overdueWake = false; // Run the job now, e.g. for a new handler
+    chrono::seconds overdueInterval{60};
+    function<void(const vector<LoanInfo>&)> overdueHandler;
+
+    // Autocomplete over titles and author names. The index is immutable;
+    // the suggest thread builds a new one after the catalog grows and
+    // swaps it in, so requests never wait for a build.
+    shared_ptr<const SuggestIndex> suggestIndex; // Guarded by suggestMutex
+    thread suggestThread;
+    mutex suggestMutex;
+    condition_variable suggestCv;
+    bool suggestStale = true; // Books added since the index was built
+    bool suggestStopping = false;
+    static constexpr uint32_t kAuthorRef = 0x80000000u; // Suggestion refs: author ids carry this bit, book ids don't
+
+    // Private constructor for singleton
+    Library() {
+        loadData();
+        snapshotThread = thread([this]() { snapshotLoop(); });
+        overdueThread = thread([this]() { overdueLoop(); });
+        suggestThread = thread([this]() { suggestLoop(); });
+    }
+
+    // Empty library with no files or snapshot thread, for benchmarks
+    struct InMemory {};
+    explicit Library(InMemory) {}
+
+public:
+
+     void startServer() {
+        if (serverRunning) return;
+        
+        // Enable CORS
+        svr.set_default_headers({
+            {"Access-Control-Allow-Origin", "*"},
+            {"Access-Control-Allow-Methods", "GET, POST, OPTIONS"},
+            {"Access-Control-Allow-Headers", "Content-Type"}
+        });
+
+        // Get all books, or with available=1 only the available ones,
+        // optionally within one genre and paged with offset/limit
+        svr.Get("/api/books", [this](const auto& req, auto& res) {
+            shared_lock<shared_mutex> lock(dataMutex);
+            string body = "[";
+            if (req.get_param_value("available") == "1") {
+                Symbol genre = SymbolTable::kMissing;
+                if (req.has_param("genre")) {
+                    genre = books.getGenreValues().find(req.get_param_value("genre"));
+                    if (genre == SymbolTable::kMissing) {
+                        res.set_content("[]", "application/json");
+                        return;
+                    }
+                }
+                size_t offset = 0, limit = books.size();
+                if (!numberParam(req, "offset", offset) || !numberParam(req, "limit", limit)) {
+                    badRequest(res, "offset and limit must be whole numbers");
+                    return;
+                }
+                vector<BookId> ids = findAvailableBooks(genre, offset, limit);
+                for (size_t i = 0; i < ids.size(); ++i) {
+                    if (i > 0) body += ',';
+                    appendBookJson(body, ids[i], true);
+                }
+            } else {
+                for (BookId id = 0; id < books.size(); ++id) {
+                    if (id > 0) body += ',';
+                    appendBookJson(body, id, true);
+                }
+            }
+            body += ']';
+            res.set_content(body, "application/json");
+        });
+
+        // Search books
+        // Substring match over title, author and genre by default;
+        // mode=terms matches whole words, all of them or with op=or any;
+        // mode=fuzzy allows maxEdits typos (by default 0-2, by query length)
+        // and ranks the results.
+        // Case and accents are ignored in every mode.
+        svr.Get("/api/books/search", [this](const auto& req, auto& res) {
+            string query = req.get_param_value("q");
+            bool availableOnly = req.get_param_value("available") == "1";
+            ItemType type = ItemType::Book;
+            bool typeOnly = req.has_param("type");
+            if (typeOnly && !parseItemType(req.get_param_value("type"), type)) {
+                res.set_content("[]", "application/json");
+                return;
+            }
+            shared_lock<shared_mutex> lock(dataMutex);
+
+            SearchMode mode = SearchMode::Substring;
+            if (req.get_param_value("mode") == "terms") {
+                mode = req.get_param_value("op") == "or" ? SearchMode::AnyTerm : SearchMode::AllTerms;
+            } else if (req.get_param_value("mode") == "fuzzy") {
+                mode = SearchMode::Fuzzy;
+            }
+            size_t maxEdits = kAutoEdits;
+            if (!numberParam(req, "maxEdits", maxEdits)) {
+                badRequest(res, "maxEdits must be a whole number");
+                return;
+            }
+            vector<BookId> results = searchBooks(query, mode, maxEdits);
+            const Bitset& available = books.getAvailability();
+            results.erase(remove_if(results.begin(), results.end(), [&](BookId id) {
+                return (availableOnly && !available.test(id)) || (typeOnly && books.getType(id) != type);
+            }), results.end());
+            
+            string body = "[";
+            for (size_t i = 0; i < results.size(); ++i) {
+                if (i > 0) body += ',';
+                appendBookJson(body, results[i], false);
+            }
+            body += ']';
+            res.set_content(body, "application/json");
+        });
+
+        // Autocomplete: up to limit (default 8) titles and author names
+        // starting with q, ignoring case and accents, most books first.
+        // Answers from the last built index, which may trail recent adds.
+        svr.Get("/api/books/suggest", [this](const auto& req, auto& res) {
+            string prefix = foldText(req.get_param_value("q"));
+            size_t limit = 8;
+            if (!numberParam(req, "limit", limit)) {
+                badRequest(res, "limit must be a whole number");
+                return;
+            }
+            limit = min<size_t>(limit, 100);
+            shared_ptr<const SuggestIndex> index;
+            {
+                lock_guard<mutex> lock(suggestMutex);
+                index = suggestIndex;
+            }
+            string body = "[";
+            if (index && !prefix.empty()) {
+                shared_lock<shared_mutex> lock(dataMutex);
+                bool first = true;
+                for (const auto& suggestion : index->complete(prefix, limit)) {
+                    body += first ? "{\"text\":" : ",{\"text\":";
+                    first = false;
+                    if (suggestion.ref & kAuthorRef) {
+                        appendJsonString(body, authors.getName(suggestion.ref & ~kAuthorRef));
+                        body += ",\"kind\":\"author\"";
+                    } else {
+                        appendJsonString(body, books.getTitle(suggestion.ref));
+                        body += ",\"kind\":\"title\"";
+                    }
+                    body += ",\"books\":" + to_string(suggestion.weight) + '}';
+                }
+            }
+            body += ']';
+            res.set_content(body, "application/json");
+        });
+
+        // Distinct genres and authors with book counts
+        svr.Get("/api/books/facets", [this](const auto&, auto& res) {
+            shared_lock<shared_mutex> lock(dataMutex);
+            json genres = json::array();
+            vector<pair<string, size_t>> genreFacets = getGenreFacets();
+            for (Symbol code = 0; code < genreFacets.size(); ++code) {
+                genres.push_back({{"name", genreFacets[code].first}, {"count", genreFacets[code].second},
+                                  {"available", countAvailableInGenre(code)}});
+            }
+            json authorList = json::array();
+            for (const auto& facet : getAuthorFacets()) {
+                authorList.push_back({{"name", facet.first}, {"count", facet.second}});
+            }
+            res.set_content(json{{"genres", genres}, {"authors", authorList}}.dump(), "application/json");
+        });
+
+        // User login
+        svr.Post("/api/login", [this](const auto& req, auto& res) {
+            auto body = json::parse(req.body);
+            string email = body["email"];
+            shared_lock<shared_mutex> lock(dataMutex);
+            User* user = findUserByEmail(email);
+            
+            if (user) {
+                res.set_content(json{
+                    {"success", true},
+                    {"name", user->getName()},
+                    {"email", user->getEmail()},
+                    {"userId", user->getUserId()}
+                }.dump(), "application/json");
+            } else {
+                res.set_content(json{{"success", false}}.dump(), "application/json");
+            }
+        });
+
+        // Register a new user
+        svr.Post("/api/register", [this](const auto& req, auto& res) {
+            auto body = json::parse(req.body);
+            string userId = body["userId"];
+            string name = body["name"];
+            string email = body["email"];
+
+            switch (registerUser(userId, name, email)) {
+                case RegisterResult::Registered:
+                    res.set_content(json{{"success", true}}.dump(), "application/json");
+                    break;
+                case RegisterResult::DuplicateId:
+                    res.set_content(json{{"success", false}, {"error", "User ID already exists"}}.dump(), "application/json");
+                    break;
+                case RegisterResult::DuplicateEmail:
+                    res.set_content(json{{"success", false}, {"error", "Email already registered"}}.dump(), "application/json");
+                    break;
+                case RegisterResult::NotSaved:
+                    res.set_content(json{{"success", false}, {"error", "Could not save the registration"}}.dump(), "application/json");
+                    break;
+            }
+        });
+
+        // Borrow or return a book by ISBN
+        auto loanHandler = [this](bool borrowing) {
+            return [this, borrowing](const httplib::Request& req, httplib::Response& res) {
+                auto body = json::parse(req.body);
+                string userId = body["userId"];
+                string isbn = body["isbn"];
+                User* user;
+                Book book;
+                {
+                    shared_lock<shared_mutex> lock(dataMutex);
+                    user = findUserById(userId);
+                    book = findBookByIsbn(isbn);
+                }
+
+                bool success = user && book &&
+                    (borrowing ? borrowBook(user, book) : returnBook(user, book));
+                res.set_content(json{{"success", success}}.dump(), "application/json");
+            };
+        };
+        svr.Post("/api/borrow", loanHandler(true));
+        svr.Post("/api/return", loanHandler(false));
+
+        // Holder of a book (?isbn=), a user's loans (?userId=) or every
+        // overdue loan (?overdue)
+        svr.Get("/api/loans", [this](const auto& req, auto& res) {
+            auto loanJson = [](const LoanInfo& loan) {
+                return json{{"userId", loan.user->getUserId()}, {"isbn", loan.book.getIsbn()},
+                            {"title", loan.book.getTitle()}, {"due", formatDay(loan.due)}};
+            };
+            shared_lock<shared_mutex> lock(dataMutex);
+            json response = json::array();
+            if (req.has_param("overdue")) {
+                for (const auto& loan : getOverdueLoans()) response.push_back(loanJson(loan));
+            } else if (req.has_param("isbn")) {
+                LoanInfo loan;
+                Book book = findBookByIsbn(req.get_param_value("isbn"));
+                if (book && findLoan(book, loan)) response.push_back(loanJson(loan));
+            } else if (User* user = findUserById(req.get_param_value("userId"))) {
+                for (const auto& loan : getLoans(user)) response.push_back(loanJson(loan));
+            }
+            res.set_content(response.dump(), "application/json");
+        });
+
+        // Persistence counters
+        svr.Get("/api/stats", [this](const auto&, auto& res) {
+            GroupCommitStats stats = getGroupCommitStats();
+            size_t total, available;
+            {
+                shared_lock<shared_mutex> lock(dataMutex);
+                total = books.size();
+                available = countAvailable();
+            }
+            res.set_content(json{
+                {"books", {
+                    {"total", total},
+                    {"available", available},
+                    {"borrowed", total - available}
+                }},
+                {"log", {
+                    {"batches", stats.batches},
+                    {"records", stats.records},
+                    {"avgBatch", stats.batches ? double(stats.records) / stats.batches : 0.0},
+                    {"maxBatch", stats.maxBatch},
+                    {"avgFlushMs", stats.batches ? stats.totalFlushMs / stats.batches : 0.0},
+                    {"maxFlushMs", stats.maxFlushMs}
+                }}
+            }.dump(), "application/json");
+        });
+
+        serverRunning = true;
+        std::thread server_thread([this]() {
+            std::cout << "Server running on http://localhost:8080\n";
+            svr.listen("localhost", 8080);
+        });
+        server_thread.detach();
+    }
+
+    void stopServer() {
+        if (serverRunning) {
+            svr.stop();
+            serverRunning = false;
+        }
+    }
+
+    // Delete copy constructor and assignment operator
+    Library(const Library&) = delete;
+    Library& operator=(const Library&) = delete;
+
+    static Library* getInstance() {
+        if (!instance) {
+            instance = new Library();
+        }
+        return instance;
+    }
+
+    // Mutations apply under the data lock, then wait for their log record
+    // to reach disk outside it so concurrent writers share one fsync. Once
+    // the log has failed they are refused, and one whose record was lost
+    // reports failure although memory already holds it. flush() then
+    // stops writing snapshots, so that change is gone after a restart, as
+    // reported.
+    Book addBook(const BookRecord& record) {
+        uint64_t seq;
+        BookId id;
+        {
+            unique_lock<shared_mutex> lock(dataMutex);
+            if (log.isFailed()) return Book();
+            id = insertBook(record);
+            seq = logMutation('B', formatBook(record));
+        }
+        if (!log.waitDurable(seq)) return Book();
+        return Book(&books, id);
+    }
+
+    enum class RegisterResult { Registered, DuplicateId, DuplicateEmail, NotSaved };
+
+    // Check for duplicates and add the user in one step
+    RegisterResult registerUser(const string& userId, const string& name, const string& email) {
+        uint64_t seq;
+        {
+            unique_lock<shared_mutex> lock(dataMutex);
+            if (log.isFailed()) return RegisterResult::NotSaved;
+            if (findUserById(userId)) return RegisterResult::DuplicateId;
+            if (findUserByEmail(email)) return RegisterResult::DuplicateEmail;
+            insertUser(userId, name, email);
+            seq = logMutation('U', formatUser(userId, name, email));
+        }
+        return log.waitDurable(seq) ? RegisterResult::Registered : RegisterResult::NotSaved;
+    }
+
+    bool borrowBook(User* user, Book book) {
+        uint64_t seq;
+        {
+            unique_lock<shared_mutex> lock(dataMutex);
+            Day due = today() + kLoanDays;
+            if (log.isFailed() || !book || !book.isAvailable() || !applyLoan(user, book, due)) {
+                return false;
+            }
+            string fields;
+            appendField(fields, user->getUserId());
+            fields += ',';
+            appendField(fields, book.getIsbn());
+            fields += ',' + to_string(fromDay(due));
+            seq = logMutation('L', fields);
+        }
+        return log.waitDurable(seq);
+    }
+
+    bool returnBook(User* user, Book book) {
+        uint64_t seq;
+        {
+            unique_lock<shared_mutex> lock(dataMutex);
+            if (log.isFailed() || !book || !applyReturn(user, book)) {
+                return false;
+            }
+            string fields;
+            appendField(fields, user->getUserId());
+            fields += ',';
+            appendField(fields, book.getIsbn());
+            seq = logMutation('R', fields);
+        }
+        return log.waitDurable(seq);
+    }
+
+    // Who holds a book, and until when
+    bool findLoan(Book book, LoanInfo& info) {
+        LoanId id = loans.findByBook(book.getId());
+        if (id == kNoLoan) return false;
+        const LoanTable::Loan& loan = loans.get(id);
+        info = LoanInfo{loan.user, book, loan.due};
+        return true;
+    }
+
+    // Loans past their due date, in the order they became overdue
+    vector<LoanInfo> getOverdueLoans() {
+        vector<LoanInfo> result;
+        for (const auto& entry : overdue.getOverdue()) {
+            if (!loans.isActive(entry.loan, entry.serial)) continue;
+            const LoanTable::Loan& loan = loans.get(entry.loan);
+            result.push_back(LoanInfo{loan.user, Book(&books, loan.book), loan.due});
+        }
+        return result;
+    }
+
+    // Called from the overdue job, outside the data lock, with each batch
+    // of loans that have just become overdue
+    void setOverdueHandler(function<void(const vector<LoanInfo>&)> handler) {
+        lock_guard<mutex> lock(overdueMutex);
+        overdueHandler = move(handler);
+        overdueWake = true;
+        overdueCv.notify_one();
+    }
+
+    void setOverdueInterval(chrono::seconds interval) {
+        lock_guard<mutex> lock(overdueMutex);
+        overdueInterval = interval;
+        overdueWake = true;
+        overdueCv.notify_one();
+    }
+
+    vector<LoanInfo> getLoans(const User* user) {
+        vector<LoanInfo> result;
+        result.reserve(user->getLoanCount());
+        loans.forEachOfUser(user, [&](LoanId, const LoanTable::Loan& loan) {
+            result.push_back(LoanInfo{loan.user, Book(&books, loan.book), loan.due});
+        });
+        return result;
+    }
+
+    void setGroupCommitPolicy(const GroupCommitPolicy& policy) {
+        log.setPolicy(policy);
+    }
+
+    GroupCommitStats getGroupCommitStats() const {
+        return log.getStats();
+    }
+
+    // The snapshot thread drops a wait begun under the old interval
+    void setSnapshotPolicy(const SnapshotPolicy& policy) {
+        lock_guard<mutex> lock(snapshotMutex);
+        snapshotPolicy = policy;
+        snapshotPolicyChanged = true;
+        snapshotCv.notify_one();
+    }
+
+    // Stop the snapshot thread, write a final snapshot if anything changed
+    // since the last one, and close the log
+    void shutdown() {
+        {
+            lock_guard<mutex> lock(suggestMutex);
+            suggestStopping = true;
+            suggestCv.notify_one();
+        }
+        if (suggestThread.joinable()) {
+            suggestThread.join();
+        }
+        {
+            lock_guard<mutex> lock(overdueMutex);
+            overdueStopping = true;
+            overdueCv.notify_one();
+        }
+        if (overdueThread.joinable()) {
+            overdueThread.join();
+        }
+        {
+            lock_guard<mutex> lock(snapshotMutex);
+            snapshotStopping = true;
+            snapshotCv.notify_one();
+        }
+        if (snapshotThread.joinable()) {
+            snapshotThread.join();
+        }
+        bool unsaved;
+        {
+            lock_guard<mutex> lock(snapshotMutex);
+            unsaved = dirty;
+        }
+        if (unsaved) flush(); // Otherwise the last snapshot is current
+        log.close();
+    }
+
+    Book findBookByTitle(const string& title) {
+        // Linear search
+        for (BookId id = 0; id < books.size(); ++id) {
+            if (books.getTitle(id) == title) {
+                return Book(&books, id);
+            }
+        }
+        return Book();
+    }
+
+    // Books by an author, or by every author in "A; B" (co-authored),
+    // ignoring case and accents. Costs the size of the postings involved,
+    // not of the catalog.
+    vector<Book> findBooksByAuthor(const string& author) {
+        vector<Book> result;
+        for (BookId id : authors.findBooksByAll(AuthorTable::splitNames(author))) {
+            result.emplace_back(&books, id);
+        }
+        return result;
+    }
+
+    // The matcher behind both the HTTP search endpoint and the CLI menu.
+    // Case and Latin accents are ignored: the catalog's text was folded
+    // when it was inserted, so only the query is folded here.
+    // Fuzzy results come best first; the others in id order.
+    vector<BookId> searchBooks(const string& query, SearchMode mode, size_t maxEdits = kAutoEdits) const {
+        string folded = foldText(query);
+        if (mode == SearchMode::Substring) return searchSubstring(folded);
+        if (mode == SearchMode::Fuzzy) {
+            if (maxEdits == kAutoEdits) maxEdits = folded.size() <= 2 ? 0 : folded.size() <= 5 ? 1 : 2;
+            vector<BookId> results;
+            for (const FuzzyMatch& match : searchFuzzy(folded, maxEdits)) results.push_back(match.id);
+            return results;
+        }
+        return termIndex.find(folded, mode == SearchMode::AllTerms);
+    }
+
+    // Books whose folded title, author or genre contains the folded query
+    // with at most maxEdits edits, fewest edits first, then by id. Each
+    // field's trigram index narrows the candidates where the query is long
+    // enough; otherwise every title and distinct value is checked.
+    vector<FuzzyMatch> searchFuzzy(const string& query, size_t maxEdits) const {
+        string_view pattern = string_view(query).substr(0, FuzzyPattern::kMaxLength);
+        maxEdits = min(maxEdits, pattern.empty() ? 0 : pattern.size() - 1); // Else anything matches
+        FuzzyPattern fuzzy(pattern);
+        vector<FuzzyMatch> matches;
+        vector<uint32_t> candidates;
+
+        if (titleTrigrams.candidatesWithin(pattern, maxEdits, candidates)) {
+            for (BookId id : candidates) {
+                size_t distance = fuzzy.distance(books.getFoldedTitle(id), maxEdits);
+                if (distance <= maxEdits) matches.push_back({id, static_cast<uint32_t>(distance)});
+            }
+        } else {
+            for (BookId id = 0; id < books.size(); ++id) {
+                size_t distance = fuzzy.distance(books.getFoldedTitle(id), maxEdits);
+                if (distance <= maxEdits) matches.push_back({id, static_cast<uint32_t>(distance)});
+            }
+        }
+
+        // Authors and genres are checked once per distinct value
+        auto matchValues = [&](const TrigramIndex& trigrams, const vector<vector<BookId>>& index, auto folded) {
+            auto check = [&](Symbol code) {
+                size_t distance = fuzzy.distance(folded(code), maxEdits);
+                if (distance > maxEdits) return;
+                for (BookId id : index[code]) matches.push_back({id, static_cast<uint32_t>(distance)});
+            };
+            if (trigrams.candidatesWithin(pattern, maxEdits, candidates)) {
+                for (Symbol code : candidates) check(code);
+            } else {
+                for (Symbol code = 0; code < index.size(); ++code) check(code);
+            }
+        };
+        matchValues(authorTrigrams, authorFieldIndex, [this](Symbol code) { return books.getFoldedAuthorValue(code); });
+        matchValues(genreTrigrams, genreIndex, [this](Symbol code) { return books.getFoldedGenreValue(code); });
+
+        // Keep each book's best field, then rank
+        sort(matches.begin(), matches.end(), [](const FuzzyMatch& a, const FuzzyMatch& b) {
+            return a.id != b.id ? a.id < b.id : a.distance < b.distance;
+        });
+        matches.erase(unique(matches.begin(), matches.end(),
+                             [](const FuzzyMatch& a, const FuzzyMatch& b) { return a.id == b.id; }),
+                      matches.end());
+        stable_sort(matches.begin(), matches.end(),
+                    [](const FuzzyMatch& a, const FuzzyMatch& b) { return a.distance < b.distance; });
+        return matches;
+    }
+
+    vector<Book> findBooksMatching(const string& query, SearchMode mode) {
+        vector<Book> result;
+        for (BookId id : searchBooks(query, mode)) result.emplace_back(&books, id);
+        return result;
+    }
+
+    // Books whose folded title, author or genre contains the folded query,
+    // in id order. Queries of three or more bytes go through the trigram
+    // indexes; shorter ones run the vector scan kernel over the titles.
+    vector<BookId> searchSubstring(const string& query) const {
+        bool indexed = query.size() >= 3;
+        vector<BookId> results;
+        if (indexed) {
+            for (BookId id : titleTrigrams.candidates(query)) {
+                if (books.getFoldedTitle(id).find(query) != string_view::npos) results.push_back(id);
+            }
+        } else {
+            results = books.findInTitles(query);
+        }
+
+        // Match each distinct author and genre value once, then expand the
+        // matching codes to books
+        size_t valueHits = 0;
+        auto matchValues = [&](const TrigramIndex& trigrams, const vector<vector<BookId>>& index, auto folded) {
+            vector<uint8_t> matches(index.size());
+            auto check = [&](Symbol code) {
+                if (folded(code).find(query) == string_view::npos) return;
+                matches[code] = 1;
+                valueHits += index[code].size();
+            };
+            if (indexed) {
+                for (Symbol code : trigrams.candidates(query)) check(code);
+            } else {
+                for (Symbol code = 0; code < index.size(); ++code) check(code);
+            }
+            return matches;
+        };
+        vector<uint8_t> authorMatches = matchValues(authorTrigrams, authorFieldIndex,
+                                                    [this](Symbol code) { return books.getFoldedAuthorValue(code); });
+        vector<uint8_t> genreMatches = matchValues(genreTrigrams, genreIndex,
+                                                   [this](Symbol code) { return books.getFoldedGenreValue(code); });
+        if (valueHits == 0) return results;
+
+        if (valueHits <= books.size() / 16) {
+            for (Symbol code = 0; code < authorMatches.size(); ++code) {
+                if (authorMatches[code]) results.insert(results.end(), authorFieldIndex[code].begin(), authorFieldIndex[code].end());
+            }
+            for (Symbol code = 0; code < genreMatches.size(); ++code) {
+                if (genreMatches[code]) results.insert(results.end(), genreIndex[code].begin(), genreIndex[code].end());
+            }
+            sort(results.begin(), results.end());
+            results.erase(unique(results.begin(), results.end()), results.end());
+        } else {
+            // Too many postings to merge; one pass over the code columns
+            vector<BookId> merged;
+            size_t next = 0; // Next title match
+            for (BookId id = 0; id < books.size(); ++id) {
+                bool titleMatch = next < results.size() && results[next] == id;
+                next += titleMatch;
+                if (titleMatch || authorMatches[books.getAuthorCode(id)] || genreMatches[books.getGenreCode(id)]) {
+                    merged.push_back(id);
+                }
+            }
+            results.swap(merged);
+        }
+        return results;
+    }
+
+    // Ignores case and accents like the other searches. Genres are few, so
+    // the folded values are compared directly; the cost is otherwise the
+    // size of the result, and the catalog itself is never reordered.
+    vector<Book> findBooksByGenre(const string& genre) {
+        string folded = foldText(genre);
+        vector<BookId> ids;
+        for (Symbol code = 0; code < genreIndex.size(); ++code) {
+            if (books.getFoldedGenreValue(code) != folded) continue;
+            size_t middle = ids.size();
+            ids.insert(ids.end(), genreIndex[code].begin(), genreIndex[code].end());
+            inplace_merge(ids.begin(), ids.begin() + middle, ids.end());
+        }
+        vector<Book> result;
+        for (BookId id : ids) result.emplace_back(&books, id);
+        return result;
+    }
+
+    size_t countAvailable() const { return books.getAvailability().count(); }
+
+    size_t countAvailableInGenre(Symbol genre) const {
+        const Bitset& available = books.getAvailability();
+        if (genreBitmaps[genre].size() > 0) {
+            return Bitset::countAnd(available, genreBitmaps[genre]);
+        }
+        size_t count = 0;
+        for (BookId id : genreIndex[genre]) count += available.test(id);
+        return count;
+    }
+
+    // Available books in id order, skipping the first offset of them. With
+    // no genre the offset is found by select() rather than a scan; within
+    // a dense genre the availability and genre bitmaps are ANDed a word at
+    // a time.
+    vector<BookId> findAvailableBooks(Symbol genre, size_t offset, size_t limit) const {
+        const Bitset& available = books.getAvailability();
+        vector<BookId> result;
+        if (limit == 0) return result;
+        if (genre == SymbolTable::kMissing) {
+            for (size_t id = available.select(offset); id < available.size() && result.size() < limit;
+                 id = available.nextSet(id + 1)) {
+                result.push_back(static_cast<BookId>(id));
+            }
+        } else if (genreBitmaps[genre].size() > 0) {
+            Bitset::forEachAnd(available, genreBitmaps[genre], [&](size_t id) {
+                if (offset > 0) {
+                    --offset;
+                    return true;
+                }
+                result.push_back(static_cast<BookId>(id));
+                return result.size() < limit;
+            });
+        } else {
+            for (BookId id : genreIndex[genre]) {
+                if (result.size() == limit) break;
+                if (!available.test(id)) continue;
+                if (offset > 0) {
+                    --offset;
+                    continue;
+                }
+                result.push_back(id);
+            }
+        }
+        return result;
+    }
+
+    // Distinct genres and authors with their book counts, for faceting
+    vector<pair<string, size_t>> getGenreFacets() const {
+        vector<pair<string, size_t>> facets;
+        for (Symbol code = 0; code < genreIndex.size(); ++code) {
+            facets.emplace_back(books.getGenreValues().get(code), genreIndex[code].size());
+        }
+        return facets;
+    }
+
+    vector<pair<string, size_t>> getAuthorFacets() const {
+        vector<pair<string, size_t>> facets;
+        for (AuthorId author = 0; author < authors.size(); ++author) {
+            facets.emplace_back(authors.getName(author), authors.getBookCount(author));
+        }
+        return facets;
+    }
+
+    User* findUserById(const string& userId) {
+        auto it = userIdIndex.find(userId);
+        return it == userIdIndex.end() ? nullptr : it->second;
+    }
+
+    User* findUserByEmail(const string& email) {
+        auto it = emailIndex.find(email);
+        return it == emailIndex.end() ? nullptr : it->second;
+    }
+
+    void displayAllBooks() {
+        // Sort ids by title; the catalog keeps insertion order
+        vector<BookId> sorted(books.size());
+        for (BookId id = 0; id < sorted.size(); ++id) sorted[id] = id;
+        stable_sort(sorted.begin(), sorted.end(), [this](BookId a, BookId b) {
+            return books.getTitle(a) < books.getTitle(b);
+        });
+
+        cout << "\n===== All Books =====\n";
+        for (BookId id : sorted) {
+            Book(&books, id).displayDetails();
+            cout << "--------------------\n";
+        }
+    }
+
+    // Write a full snapshot now and drop the log records it covers. The
+    // log is rotated without the data lock, and the capture holds it
+    // shared only while copying views of the books, users and loans; the
+    // file is written without it.
+    void flush() {
+        lock_guard<mutex> writeLock(snapshotWriteMutex);
+        log.rotate();
+        SnapshotImage image;
+        {
+            shared_lock<shared_mutex> lock(dataMutex);
+            image = captureSnapshot();
+        }
+        // The image may hold mutations whose records were lost; writing it
+        // would make changes durable that callers were told had failed
+        if (!log.waitDurable(image.lsn)) {
+            cerr << "Mutation log failed; not saving a snapshot.\n";
+            return;
+        }
+
+        SnapshotFormat format;
+        {
+            lock_guard<mutex> lock(snapshotMutex);
+            format = snapshotPolicy.format;
+        }
+        bool written;
+        if (format == SnapshotFormat::Binary) {
+            string path = binarySnapshotPath(image.lsn);
+            // The mapped snapshot already holds this state and cannot be replaced
+            written = path == snapshotFilePath || writeBinarySnapshot(image, path);
+        } else {
+            written = writeSnapshot(image, "library_data.txt");
+        }
+        if (written) {
+            log.dropRotated();
+            removeBinarySnapshotsBefore(image.lsn);
+        } else {
+            cerr << "Error saving data to file.\n";
+            lock_guard<mutex> lock(snapshotMutex);
+            dirty = true; // Try again on the next trigger or at shutdown
+        }
+    }
+
+    // Rebuild state from the last snapshot plus the log tail. A rotated log
+    // left behind by an interrupted snapshot is replayed first.
+    void loadData() {
+        loadSnapshot();
+        replayLog(log.getRotatedPath());
+        replayLog(log.getPath());
+    }
+
+private:
+    // Read an optional numeric query parameter; value keeps its default
+    // when the parameter is absent. False if it is present but malformed.
+    static bool numberParam(const httplib::Request& req, const char* name, size_t& value) {
+        return !req.has_param(name) || parseNumber(req.get_param_value(name), value);
+    }
+
+    static void badRequest(httplib::Response& res, const string& error) {
+        res.status = 400;
+        res.set_content(json{{"success", false}, {"error", error}}.dump(), "application/json");
+    }
+
+    // One book as a JSON object, written without temporaries. Listings
+    // include genre and year; search results leave them out.
+    void appendBookJson(string& out, BookId id, bool withDetails) const {
+        out += "{\"title\":";
+        appendJsonString(out, books.getTitle(id));
+        out += ",\"author\":";
+        appendJsonString(out, books.getAuthor(id));
+        out += ",\"isbn\":";
+        appendJsonString(out, books.getIsbn(id));
+        if (withDetails) {
+            out += ",\"genre\":";
+            appendJsonString(out, books.getGenre(id));
+            char year[16];
+            auto end = to_chars(year, year + sizeof(year), books.getPublicationYear(id)).ptr;
+            out += ",\"year\":";
+            out.append(year, end);
+        }
+        books.visitDetails(id, [&out](const auto& info) {
+            using Info = decay_t<decltype(info)>;
+            if constexpr (!is_same_v<Info, monostate>) {
+                out += ",\"type\":\"";
+                out += ItemTraits<Info>::name;
+                out += "\",\"";
+                out += ItemTraits<Info>::field;
+                out += "\":";
+                if constexpr (is_same_v<Info, EBookInfo>) {
+                    appendJsonString(out, ItemTraits<Info>::value(info));
+                } else {
+                    out += to_string(ItemTraits<Info>::value(info));
+                }
+            }
+        });
+        out += books.isAvailable(id) ? ",\"available\":true}" : ",\"available\":false}";
+    }
+
+    // Caller holds dataMutex exclusively; returns the record's sequence number
+    uint64_t logMutation(char op, const string& fields) {
+        log.append(++lastSeq, op, fields);
+
+        lock_guard<mutex> lock(snapshotMutex);
+        dirty = true;
+        lastMutation = chrono::steady_clock::now();
+        if (log.getBytes() >= snapshotPolicy.maxLogBytes ||
+            log.getRecords() >= snapshotPolicy.maxLogRecords) {
+            snapshotRequested = true;
+            snapshotCv.notify_one();
+        }
+        return lastSeq;
+    }
+
+    // Snapshot when a log trigger fires or the interval
+    // passes with unsaved mutations. A burst of mutations is allowed to
+    // finish first (up to maxDelay) so it ends up in a single write.
+    void snapshotLoop() {
+        unique_lock<mutex> lock(snapshotMutex);
+        while (!snapshotStopping) {
+            bool woken = snapshotCv.wait_for(lock, snapshotPolicy.interval, [this]() {
+                return snapshotRequested || snapshotStopping || snapshotPolicyChanged;
+            });
+            if (snapshotStopping) break;
+            snapshotPolicyChanged = false;
+            if (woken && !snapshotRequested) continue; // Only the policy changed
+            snapshotRequested = false;
+            if (!dirty) continue;
+
+            auto deadline = chrono::steady_clock::now() + snapshotPolicy.maxDelay;
+            while (!snapshotStopping) {
+                auto until = min(lastMutation + snapshotPolicy.debounce, deadline);
+                if (chrono::steady_clock::now() >= until) break;
+                snapshotCv.wait_until(lock, until);
+            }
+            if (snapshotStopping) break; // shutdown() writes the final snapshot
+
+            dirty = false;
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    // Caller holds dataMutex
+    SnapshotImage captureSnapshot() const {
+        SnapshotImage image;
+        image.lsn = lastSeq;
+        image.books.reserve(books.size());
+        for (BookId id = 0; id < books.size(); ++id) {
+            image.books.push_back(books.getFields(id));
+        }
+        image.users.reserve(users.size());
+        for (auto user : users) {
+            SnapshotImage::UserRow row{user->getUserId(), user->getName(), user->getEmail(), {}};
+            loans.forEachOfUser(user, [&](LoanId, const LoanTable::Loan& loan) {
+                row.loans.emplace_back(books.getIsbn(loan.book), fromDay(loan.due));
+            });
+            image.users.push_back(move(row));
+        }
+        return image;
+    }
+
+    static bool writeSnapshot(const SnapshotImage& image, const string& path) {
+        string out;
+
+        // Sequence number of the last mutation included in this snapshot
+        out += "[META]\n";
+        out += "lsn," + to_string(image.lsn) + "\n";
+
+        // Save books
+        out += "[BOOKS]\n";
+        for (const auto& book : image.books) {
+            out += formatBook(book);
+            out += '\n';
+        }
+
+        // Save users
+        out += "[USERS]\n";
+        for (const auto& user : image.users) {
+            out += formatUser(user.userId, user.name, user.email);
+            out += '\n';
+
+            // Save borrowed books
+            out += "[BORROWED]";
+            out += user.userId;
+            out += '\n';
+            for (const auto& loan : user.loans) {
+                appendField(out, loan.first);
+                out += "," + to_string(loan.second) + "\n";
+            }
+        }
+
+        return writeFileAtomically(path, out);
+    }
+
+    static bool writeBinarySnapshot(const SnapshotImage& image, const string& path) {
+        string strings;
+        auto addString = [&strings](string_view value) {
+            uint32_t ref = static_cast<uint32_t>(strings.size());
+            uint32_t length = static_cast<uint32_t>(value.size());
+            strings.append(reinterpret_cast<const char*>(&length), sizeof(length));
+            strings.append(value);
+            return ref;
+        };
+
+        unordered_map<string_view, uint32_t> bookIndex;
+        size_t bookCount = image.books.size();
+        vector<uint32_t> bookText(bookCount * 4);
+        vector<int32_t> years(bookCount);
+        vector<uint8_t> available(bookCount);
+        vector<uint32_t> detailBook, detailField;
+        vector<uint8_t> detailType;
+        for (size_t i = 0; i < bookCount; ++i) {
+            const BookFields& book = image.books[i];
+            if (book.details.index() != 0) {
+                detailBook.push_back(static_cast<uint32_t>(i));
+                detailField.push_back(addString(itemDetailText(book.details)));
+                detailType.push_back(static_cast<uint8_t>(book.details.index()));
+            }
+            bookText[i] = addString(book.title);
+            bookText[bookCount + i] = addString(book.author);
+            bookText[bookCount * 2 + i] = addString(book.isbn);
+            bookText[bookCount * 3 + i] = addString(book.genre);
+            years[i] = book.publicationYear;
+            available[i] = book.available ? 1 : 0;
+            bookIndex.emplace(book.isbn, static_cast<uint32_t>(i));
+        }
+
+        size_t userCount = image.users.size();
+        vector<uint32_t> userText(userCount * 3);
+        vector<int64_t> loanDue;
+        vector<uint32_t> loanUser, loanBook;
+        for (size_t i = 0; i < userCount; ++i) {
+            const auto& user = image.users[i];
+            userText[i] = addString(user.userId);
+            userText[userCount + i] = addString(user.name);
+            userText[userCount * 2 + i] = addString(user.email);
+            for (const auto& loan : user.loans) {
+                auto it = bookIndex.find(loan.first);
+                if (it == bookIndex.end()) continue;
+                loanDue.push_back(loan.second);
+                loanUser.push_back(static_cast<uint32_t>(i));
+                loanBook.push_back(it->second);
+            }
+        }
+        if (strings.size() > numeric_limits<uint32_t>::max()) {
+            cerr << "Error saving data to file: string table too large.\n";
+            return false;
+        }
+
+        BinarySnapshotHeader header{};
+        memcpy(header.magic, kBinarySnapshotMagic, sizeof(header.magic));
+        header.version = kBinarySnapshotVersion;
+        header.byteOrder = kBinarySnapshotByteOrder;
+        header.lsn = image.lsn;
+        header.bookCount = bookCount;
+        header.userCount = userCount;
+        header.loanCount = loanDue.size();
+        header.loansOffset = alignTo8(sizeof(header));
+        header.booksOffset = alignTo8(header.loansOffset + header.loanCount * 16);
+        header.usersOffset = alignTo8(header.booksOffset + bookCount * 21);
+        header.detailCount = detailBook.size();
+        header.detailsOffset = alignTo8(header.usersOffset + userCount * 12);
+        header.stringsOffset = alignTo8(header.detailsOffset + header.detailCount * 9);
+        header.stringsSize = strings.size();
+
+        string buffer(header.stringsOffset + strings.size(), '\0');
+        auto put = [&buffer](uint64_t offset, const void* src, size_t bytes) {
+            if (bytes) memcpy(&buffer[offset], src, bytes);
+        };
+        put(0, &header, sizeof(header));
+        put(header.loansOffset, loanDue.data(), loanDue.size() * 8);
+        put(header.loansOffset + header.loanCount * 8, loanUser.data(), loanUser.size() * 4);
+        put(header.loansOffset + header.loanCount * 12, loanBook.data(), loanBook.size() * 4);
+        put(header.booksOffset, bookText.data(), bookText.size() * 4);
+        put(header.booksOffset + bookCount * 16, years.data(), years.size() * 4);
+        put(header.booksOffset + bookCount * 20, available.data(), available.size());
+        put(header.usersOffset, userText.data(), userText.size() * 4);
+        put(header.detailsOffset, detailBook.data(), detailBook.size() * 4);
+        put(header.detailsOffset + header.detailCount * 4, detailField.data(), detailField.size() * 4);
+        put(header.detailsOffset + header.detailCount * 8, detailType.data(), detailType.size());
+        put(header.stringsOffset, strings.data(), strings.size());
+
+        return writeFileAtomically(path, buffer);
+    }
+
+    // Takes a BookRecord or BookFields
+    template <typename Record>
+    static string formatBook(const Record& book) {
+        string row;
+        appendField(row, book.title);
+        row += ',';
+        appendField(row, book.author);
+        row += ',';
+        appendField(row, book.isbn);
+        row += ',';
+        appendField(row, book.genre);
+        row += ',' + to_string(book.publicationYear) + ',' + (book.available ? '1' : '0');
+        // Other item types append "<type>,<field>"; book rows stay as before
+        if (book.details.index() != 0) {
+            row += ',';
+            row += itemTypeName(static_cast<ItemType>(book.details.index()));
+            row += ',';
+            appendField(row, itemDetailText(book.details));
+        }
+        return row;
+    }
+
+    static string formatUser(string_view userId, string_view name, string_view email) {
+        string row;
+        appendField(row, userId);
+        row += ',';
+        appendField(row, name);
+        row += ',';
+        appendField(row, email);
+        return row;
+    }
+
+public:
+    // Parse a [BOOKS] row; returns false for a malformed row
+    static bool parseBook(string_view line, BookRecord& book) {
+        RecordReader reader(line);
+        string_view field;
+        int available = 1;
+
+        if (!reader.next(field)) return false;
+        book.title = string(field);
+        if (!reader.next(field)) return false;
+        book.author = string(field);
+        if (!reader.next(field)) return false;
+        book.isbn = string(field);
+        if (!reader.next(field)) return false;
+        book.genre = string(field);
+        if (!reader.nextNumber(book.publicationYear)) return false;
+        reader.nextNumber(available);
+        book.available = available != 0;
+        string_view type;
+        if (reader.next(type) && !type.empty()) {
+            if (!reader.next(field) || !parseItemDetails(type, field, book.details)) return false;
+        }
+        return true;
+    }
+
+private:
+    // Fields of a "<userId>,<name>,<email>" row
+    static bool parseUser(string_view line, string& userId, string& name, string& email) {
+        RecordReader reader(line);
+        string_view field;
+        if (!reader.next(field)) return false;
+        userId = string(field);
+        if (!reader.next(field)) return false;
+        name = string(field);
+        if (!reader.next(field)) return false;
+        email = string(field);
+        return true;
+    }
+
+    // Fields of an "<isbn>,<due>" loan row
+    static bool parseLoan(string_view line, string& isbn, time_t& dueDate) {
+        RecordReader reader(line);
+        string_view field;
+        int64_t due;
+        if (!reader.next(field)) return false;
+        isbn = string(field);
+        if (!reader.nextNumber(due)) return false;
+        dueDate = static_cast<time_t>(due);
+        return true;
+    }
+
+    // Number of fields in a record, honouring quotes
+    static size_t countFields(string_view line) {
+        RecordReader reader(line);
+        string_view field;
+        size_t fields = 0;
+        while (reader.next(field)) ++fields;
+        return fields;
+    }
+
+    // A book read back from disk as on loan is unavailable whatever its
+    // stored flag says. A second loan of the same book is ignored.
+    void restoreLoan(User* user, const string& isbn, time_t dueDate) {
+        if (Book book = findBookByIsbn(isbn)) {
+            applyLoan(user, book, toDay(dueDate));
+        }
+    }
+
+    bool applyLoan(User* user, Book book, Day due) {
+        if (loans.findByBook(book.getId()) != kNoLoan) return false;
+        LoanId id = loans.checkout(user, book.getId(), due);
+        overdue.schedule({id, loans.get(id).serial, due});
+        book.setAvailable(false);
+        return true;
+    }
+
+    void overdueLoop() {
+        unique_lock<mutex> lock(overdueMutex);
+        while (true) {
+            overdueCv.wait_for(lock, overdueInterval, [this]() { return overdueStopping || overdueWake; });
+            if (overdueStopping) break;
+            overdueWake = false;
+
+            vector<LoanInfo> batch;
+            {
+                unique_lock<shared_mutex> dataLock(dataMutex);
+                auto fresh = overdue.advance(today(), [this](const OverdueScheduler::Entry& entry) {
+                    return loans.isActive(entry.loan, entry.serial);
+                });
+                for (const auto& entry : fresh) {
+                    const LoanTable::Loan& loan = loans.get(entry.loan);
+                    batch.push_back(LoanInfo{loan.user, Book(&books, loan.book), loan.due});
+                }
+            }
+            if (batch.empty() || !overdueHandler) continue;
+            // Call a copy with the lock released, so the handler may itself
+            // call setOverdueHandler or setOverdueInterval
+            auto handler = overdueHandler;
+            lock.unlock();
+            handler(batch);
+            lock.lock();
+        }
+    }
+
+    // Titles and author names as autocomplete keys, weighted by their
+    // number of books. Titles were folded on insert; the far fewer author
+    // names are folded here, into foldedNames. The title keys view catalog
+    // text, which is never moved or freed, so they outlive the lock.
+    vector<SuggestIndex::Key> collectSuggestKeys(vector<string>& foldedNames) const {
+        shared_lock<shared_mutex> lock(dataMutex);
+        vector<SuggestIndex::Key> keys;
+        keys.reserve(books.size() + authors.size());
+        for (BookId id = 0; id < books.size(); ++id) keys.push_back({books.getFoldedTitle(id), id, 1});
+        foldedNames.resize(authors.size());
+        for (AuthorId author = 0; author < authors.size(); ++author) {
+            foldedNames[author] = foldText(authors.getName(author));
+            keys.push_back({foldedNames[author], author | kAuthorRef, static_cast<uint32_t>(authors.getBookCount(author))});
+        }
+        return keys;
+    }
+
+    // Sorting and encoding happen outside the data lock
+    shared_ptr<const SuggestIndex> buildSuggestIndex() const {
+        vector<string> foldedNames;
+        return make_shared<const SuggestIndex>(collectSuggestKeys(foldedNames));
+    }
+
+    void suggestLoop() {
+        unique_lock<mutex> lock(suggestMutex);
+        while (true) {
+            suggestCv.wait(lock, [this]() { return suggestStopping || suggestStale; });
+            if (suggestStopping) break;
+            suggestStale = false; // Books added during the build trigger another
+            lock.unlock();
+            shared_ptr<const SuggestIndex> index = buildSuggestIndex();
+            lock.lock();
+            suggestIndex = move(index);
+        }
+    }
+
+    bool applyReturn(User* user, Book book) {
+        LoanId id = loans.findByBook(book.getId());
+        if (id == kNoLoan || loans.get(id).user != user) return false;
+        loans.checkin(id);
+        book.setAvailable(true);
+        return true;
+    }
+
+    // Add to storage and indexes. The first book or user with a given key
+    // wins, as it did with the linear scans.
+    BookId insertBook(const BookRecord& book) {
+        return indexBook(books.add(book));
+    }
+
+    // For text that outlives the library, such as the mapped snapshot
+    BookId insertBookViews(const BookFields& book) {
+        return indexBook(books.addViews(book));
+    }
+
+    BookId indexBook(BookId id) {
+        isbnIndex.emplace(books.getIsbn(id), id); // Keyed by the catalog's own copy
+        Symbol genre = books.getGenreCode(id);
+        if (genre == genreIndex.size()) {
+            genreIndex.emplace_back();
+            genreBitmaps.emplace_back();
+            genreTrigrams.add(genre, books.getFoldedGenreValue(genre));
+        }
+        vector<BookId>& postings = genreIndex[genre];
+        postings.push_back(id);
+        Bitset& bitmap = genreBitmaps[genre];
+        if (bitmap.size() > 0) {
+            bitmap.resize(id + 1);
+            bitmap.set(id, true);
+        } else if (postings.size() >= kDenseGenreBooks && postings.size() * 32 >= books.size()) {
+            bitmap.reserve(books.size());
+            for (BookId member : postings) {
+                bitmap.resize(member + 1);
+                bitmap.set(member, true);
+            }
+        }
+        authors.addBook(id, books.getAuthor(id));
+        termIndex.addBook(books, id);
+        titleTrigrams.add(id, books.getFoldedTitle(id));
+        Symbol authorField = books.getAuthorCode(id);
+        if (authorField == authorFieldIndex.size()) {
+            authorFieldIndex.emplace_back();
+            authorTrigrams.add(authorField, books.getFoldedAuthorValue(authorField));
+        }
+        authorFieldIndex[authorField].push_back(id);
+        {
+            lock_guard<mutex> lock(suggestMutex);
+            suggestStale = true;
+        }
+        suggestCv.notify_one();
+        return id;
+    }
+
+    User* insertUser(string_view userId, string_view name, string_view email) {
+        return insertUserViews(userText.add(userId), userText.add(name), userText.add(email));
+    }
+
+    // For text that outlives the library, such as the mapped snapshot
+    User* insertUserViews(string_view userId, string_view name, string_view email) {
+        User* user = userPool.create(userId, name, email);
+        users.push_back(user);
+        userIdIndex.emplace(user->getUserId(), user);
+        emailIndex.emplace(user->getEmail(), user);
+        return user;
+    }
+
+    // Sequence number recorded in the [META] section of a text snapshot
+    static uint64_t peekTextSnapshotLsn(const string& path) {
+        ifstream inFile(path);
+        string line;
+        if (getline(inFile, line) && line == "[META]" && getline(inFile, line) &&
+            line.compare(0, 4, "lsn,") == 0) {
+            uint64_t lsn = 0;
+            if (parseNumber(string_view(line).substr(4), lsn)) return lsn;
+            cerr << "Ignoring malformed snapshot LSN in " << path << "\n";
+        }
+        return 0;
+    }
+
+    static string binarySnapshotPath(uint64_t lsn) {
+        return "library_data." + to_string(lsn) + ".bin";
+    }
+
+    // Numbered binary snapshots in the working directory by sequence number
+    static vector<pair<uint64_t, string>> listBinarySnapshots() {
+        vector<pair<uint64_t, string>> result;
+        error_code error;
+        for (const auto& entry : filesystem::directory_iterator(".", error)) {
+            string name = entry.path().filename().string();
+            const size_t prefix = strlen("library_data."), suffix = strlen(".bin");
+            uint64_t lsn;
+            if (name.size() > prefix + suffix && name.compare(0, prefix, "library_data.") == 0 &&
+                name.compare(name.size() - suffix, suffix, ".bin") == 0 &&
+                parseNumber(string_view(name).substr(prefix, name.size() - prefix - suffix), lsn)) {
+                result.emplace_back(lsn, name);
+            }
+        }
+        sort(result.begin(), result.end());
+        return result;
+    }
+
+    // Binary snapshots superseded by the one at lsn, except the one still
+    // mapped; that goes once a later run has loaded something newer
+    void removeBinarySnapshotsBefore(uint64_t lsn) {
+        for (const auto& snapshot : listBinarySnapshots()) {
+            if (snapshot.first < lsn && snapshot.second != snapshotFilePath) remove(snapshot.second.c_str());
+        }
+        if (snapshotFilePath != "library_data.bin") remove("library_data.bin");
+    }
+
+    // Load whichever snapshot is newer: the newest binary image or the
+    // text file
+    void loadSnapshot() {
+        vector<pair<uint64_t, string>> binaries = listBinarySnapshots();
+        string path = binaries.empty() ? "library_data.bin" : binaries.back().second;
+        bool haveBinary = snapshotFile.open(path);
+        ifstream textFile("library_data.txt");
+        if (haveBinary && (!textFile || snapshotFile.getLsn() >= peekTextSnapshotLsn("library_data.txt"))) {
+            snapshotFilePath = path;
+            loadBinarySnapshot(snapshotFile);
+        } else {
+            snapshotFile.close();
+            loadTextSnapshot();
+        }
+    }
+
+    // Titles, ISBNs and user fields stay in the mapping as views; only
+    // the indexes and the folded search text are built
+    void loadBinarySnapshot(const BinarySnapshotView& view) {
+        lastSeq = view.getLsn();
+        books.reserve(view.bookCount());
+        size_t detail = 0; // Detail rows are in book order
+        for (size_t i = 0; i < view.bookCount(); ++i) {
+            BookFields book{view.bookTitle(i), view.bookAuthor(i), view.bookIsbn(i),
+                            view.bookGenre(i), view.bookYear(i), view.bookAvailable(i), {}};
+            if (detail < view.detailCount() && view.detailBook(detail) == i) {
+                parseItemDetails(itemTypeName(view.detailType(detail)), view.detailField(detail), book.details);
+                ++detail;
+            }
+            insertBookViews(book);
+        }
+        users.reserve(view.userCount());
+        userPool.reserve(view.userCount());
+        for (size_t i = 0; i < view.userCount(); ++i) {
+            insertUserViews(view.userId(i), view.userName(i), view.userEmail(i));
+        }
+        // Loans reference rows directly, so no ISBN lookups are needed
+        for (size_t i = 0; i < view.loanCount(); ++i) {
+            applyLoan(users[view.loanUser(i)], Book(&books, static_cast<BookId>(view.loanBook(i))),
+                      toDay(view.loanDue(i)));
+        }
+    }
+
+    // Parse library_data.txt on all cores. [BOOKS] and [USERS] are split
+    // into newline-aligned chunks; rows are merged back in file order, and
+    // loans are resolved once every book is loaded.
+    void loadTextSnapshot() {
+        MappedFile file;
+        if (!file.open("library_data.txt")) {
+            return; // No existing data file
+        }
+        string_view text(file.getData(), file.getSize());
+
+        size_t booksPos = findSection(text, "[BOOKS]", 0);
+        size_t usersPos = findSection(text, "[USERS]", booksPos == string_view::npos ? 0 : booksPos);
+        size_t booksEnd = usersPos == string_view::npos ? text.size() : usersPos;
+
+        if (text.compare(0, 7, "[META]\n") == 0) {
+            lastSeq = peekTextSnapshotLsn("library_data.txt");
+        }
+
+        // Users rows carry the loans that follow them until the next user
+        struct UserRow {
+            bool isUser = false; // Otherwise a loan row
+            string userId, name, email;
+            string isbn;
+            time_t dueDate = 0;
+        };
+
+        // The two sections share one thread per core, split by their size.
+        // With a single core they are parsed one after the other.
+        string_view bookRegion = booksPos == string_view::npos ? string_view() : sectionBody(text, booksPos, booksEnd);
+        string_view userRegion = usersPos == string_view::npos ? string_view() : sectionBody(text, usersPos, text.size());
+        size_t cores = max(1u, thread::hardware_concurrency());
+        size_t bookThreads = cores;
+        size_t userThreads = cores;
+        bool concurrent = cores > 1 && !bookRegion.empty() && !userRegion.empty();
+        if (concurrent) {
+            bookThreads = cores * bookRegion.size() / (bookRegion.size() + userRegion.size());
+            bookThreads = min(max<size_t>(bookThreads, 1), cores - 1);
+            userThreads = cores - bookThreads;
+        }
+
+        vector<BookRecord> loadedBooks;
+        vector<UserRow> userRows;
+        auto parseBooks = [&loadedBooks, bookRegion, bookThreads]() {
+            loadedBooks = parseLinesParallel<BookRecord>(bookRegion, bookThreads, [](string_view line, vector<BookRecord>& out) {
+                BookRecord book;
+                if (parseBook(line, book)) out.push_back(move(book));
+            });
+        };
+        thread booksThread;
+        if (concurrent) {
+            booksThread = thread(parseBooks);
+        } else if (!bookRegion.empty()) {
+            parseBooks();
+        }
+        if (!userRegion.empty()) {
+            userRows = parseLinesParallel<UserRow>(userRegion, userThreads, [](string_view line, vector<UserRow>& out) {
+                if (line[0] == '[') return; // [BORROWED]<userId> header
+                UserRow row;
+                // writeSnapshot() puts the next user row right after a
+                // [BORROWED] block, so a row with three fields is a user
+                if (countFields(line) >= 3) {
+                    if (!parseUser(line, row.userId, row.name, row.email)) return;
+                    row.isUser = true;
+                } else if (!parseLoan(line, row.isbn, row.dueDate)) {
+                    return;
+                }
+                out.push_back(move(row));
+            });
+        }
+        if (booksThread.joinable()) {
+            booksThread.join();
+        }
+
+        books.reserve(loadedBooks.size());
+        isbnIndex.reserve(loadedBooks.size());
+        for (auto& book : loadedBooks) {
+            insertBook(move(book));
+        }
+        userPool.reserve(count_if(userRows.begin(), userRows.end(), [](const UserRow& row) { return row.isUser; }));
+        User* currentUser = nullptr;
+        for (auto& row : userRows) {
+            if (row.isUser) {
+                currentUser = insertUser(row.userId, row.name, row.email);
+            } else if (currentUser) {
+                restoreLoan(currentUser, row.isbn, row.dueDate);
+            }
+        }
+    }
+
+    // Offset of a "[NAME]" line at or after from, or npos
+    static size_t findSection(string_view text, string_view name, size_t from) {
+        for (size_t pos = text.find(name, from); pos != string_view::npos; pos = text.find(name, pos + 1)) {
+            bool lineStart = pos == 0 || text[pos - 1] == '\n';
+            size_t after = pos + name.size();
+            bool lineEnd = after == text.size() || text[after] == '\n' || text[after] == '\r';
+            if (lineStart && lineEnd) return pos;
+        }
+        return string_view::npos;
+    }
+
+    // Lines between a section header at pos and end
+    static string_view sectionBody(string_view text, size_t pos, size_t end) {
+        size_t bodyStart = text.find('\n', pos);
+        if (bodyStart == string_view::npos || bodyStart + 1 >= end) return string_view();
+        return text.substr(bodyStart + 1, end - bodyStart - 1);
+    }
+
+    // Apply log records newer than the snapshot, in order
+    void replayLog(const string& path) {
+        ifstream inFile(path);
+        if (!inFile) {
+            return; // Nothing logged since the last snapshot
+        }
+
+        string line;
+        long long offset = 0; // End of the last complete record
+        while (getline(inFile, line)) {
+            if (inFile.eof()) {
+                // No newline: a crash tore the last record. Cut it off so
+                // the next append does not run on from it.
+                if (!truncateFile(path, offset)) cerr << "Error truncating torn record in " << path << ".\n";
+                break;
+            }
+            offset += static_cast<long long>(line.size()) + 1;
+            RecordReader reader(line);
+            uint64_t seq;
+            string_view op;
+            if (!reader.nextNumber(seq) || !reader.next(op) || op.size() != 1) {
+                cerr << "Skipping malformed record in " << path << ".\n";
+                continue;
+            }
+            if (seq <= lastSeq) {
+                continue; // Already part of the snapshot
+            }
 
+            string_view fields = reader.remainder();
+            string_view field;
+            string userId, isbn;
+            switch (op[0]) {
+                case 'B': {
+                    BookRecord book;
+                    if (parseBook(fields, book)) insertBook(move(book));
+                    break;
+                }
+                case 'U': {
+                    string name, email;
+                    if (parseUser(fields, userId, name, email)) insertUser(userId, name, email);
+                    break;
+                }
+                case 'L': {
+                    if (!reader.next(field)) break;
+                    userId = string(field);
+                    time_t dueDate;
+                    if (!parseLoan(reader.remainder(), isbn, dueDate)) break;
+                    User* user = findUserById(userId);
+                    if (user) restoreLoan(user, isbn, dueDate);
+                    break;
+                }
+                case 'R': {
+                    if (!reader.next(field)) break;
+                    userId = string(field);
+                    if (!reader.next(field)) break;
+                    isbn = string(field);
+                    User* user = findUserById(userId);
+                    Book book = findBookByIsbn(isbn);
+                    if (user && book) applyReturn(user, book);
+                    break;
+                }
+            }
+            lastSeq = seq;
+            log.noteReplayed(seq, line.size() + 1);
+        }
+    }
 
-// Forward declarations
-class Book;
-class User;
+public:
+    Book findBookByIsbn(string_view isbn) {
+        auto it = isbnIndex.find(isbn);
+        return it == isbnIndex.end() ? Book() : Book(&books, it->second);
+    }
 
-// Abstract base class for library items
-class LibraryItem {
-protected:
-    string title;
-    string id;
-    bool available;
+    const Catalog& getCatalog() const { return books; }
+    const vector<User*>& getAllUsers() const { return users; }
+};
 
-public:
-    LibraryItem(const string& title, const string& id) 
-        : title(title), id(id), available(true) {}
+// Initialize static member
+Library* Library::instance = nullptr;
 
-    virtual ~LibraryItem() {}
+namespace {
 
-    string getTitle() const { return title; }
-    string getId() const { return id; }
-    bool isAvailable() const { return available; }
-    void setAvailable(bool status) { available = status; }
+double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
 
-    virtual void displayDetails() const = 0;
-};
+void reportBenchmark(const string& label, size_t items, double ms) {
+    cout << left << setw(28) << label << right << setw(10) << fixed << setprecision(1) << ms
+         << " ms  " << setw(10) << static_cast<size_t>(items / (ms / 1000.0)) << " items/s\n";
+}
 
-// Book class inheriting from LibraryItem
-class Book : public LibraryItem {
-    string author;
-    string isbn;
-    string genre;
+// The [BOOKS] row parser loadData() used before RecordReader
+BookRecord legacyParseBook(const string& line) {
+    stringstream ss(line);
+    string title, author, isbn, genre;
     int publicationYear;
+    bool available;
 
-public:
-    Book(const string& title, const string& author, const string& isbn, 
-         const string& genre, int publicationYear)
-        : LibraryItem(title, isbn), author(author), isbn(isbn), 
-          genre(genre), publicationYear(publicationYear) {}
-
-    string getAuthor() const { return author; }
-    string getIsbn() const { return isbn; }
-    string getGenre() const { return genre; }
-    int getPublicationYear() const { return publicationYear; }
+    getline(ss, title, ',');
+    getline(ss, author, ',');
+    getline(ss, isbn, ',');
+    getline(ss, genre, ',');
+    ss >> publicationYear;
+    ss.ignore(); // Ignore comma
+    ss >> available;
 
-    void displayDetails() const override {
-        cout << "Title: " << title << "\n"
-             << "Author: " << author << "\n"
-             << "ISBN: " << isbn << "\n"
-             << "Genre: " << genre << "\n"
-             << "Publication Year: " << publicationYear << "\n"
-             << "Available: " << (available ? "Yes" : "No") << "\n";
-    }
-};
+    return BookRecord{title, author, isbn, genre, publicationYear, available, {}};
+}
 
-// User class
-class User {
-    string userId;
-    string name;
-    string email;
-    vector<pair<Book*, time_t>> borrowedBooks; // Book pointer and due date
+} // namespace
 
+// Micro-benchmarks, run with --bench <name> [size]
+class Benchmarks {
 public:
-    User(const string& userId, const string& name, const string& email)
-        : userId(userId), name(name), email(email) {}
-
-    string getUserId() const { return userId; }
-    string getName() const { return name; }
-    string getEmail() const { return email; }
-    const vector<pair<Book*, time_t>>& getBorrowedBooks() const { return borrowedBooks; }
-
-    bool borrowBook(Book* book) {
-        if (book && book->isAvailable()) {
-            book->setAvailable(false);
-            time_t now = time(nullptr);
-            time_t dueDate = now + 14 * 24 * 60 * 60; // 14 days in seconds
-            borrowedBooks.emplace_back(book, dueDate);
-            return true;
-        }
-        return false;
+    static int run(const string& name, size_t size) {
+        if (name == "load") return load(size ? size : 2000000);
+        if (name == "lookup") return lookups(size ? size : 1000000);
+        if (name == "users") return users(size ? size : 2000000);
+        if (name == "availability") return availability(size ? size : 10000000);
+        if (name == "items") return items(size ? size : 2000000);
+        if (name == "overdue") return overdueScan(size ? size : 1000000);
+        if (name == "search") return search(size ? size : 2000000);
+        if (name == "scan") return scan(size ? size : 2000000);
+        if (name == "fuzzy") return fuzzy(size ? size : 1000000);
+        if (name == "suggest") return suggest(size ? size : 1000000);
+        cerr << "Unknown benchmark: " << name << "\n";
+        return 1;
     }
 
-    bool returnBook(Book* book) {
-        for (auto it = borrowedBooks.begin(); it != borrowedBooks.end(); ++it) {
-            if (it->first == book) {
-                book->setAvailable(true);
-                borrowedBooks.erase(it);
-                return true;
+private:
+    static int load(size_t lines);
+    static int lookups(size_t maxUsers);
+    static int users(size_t count);
+    static int availability(size_t books);
+    static int items(size_t count);
+    static int overdueScan(size_t loans);
+    // The generated catalog the search benchmarks share: three-word titles
+    // from a 20000-word vocabulary, low ranks common, over 5000 authors
+    // and 40 genres
+    static string benchWord(size_t n) { return "w" + to_string(n * 2654435761u % 1000003); }
+    static void fillSearchCatalog(Library& library, size_t books);
+
+    static int search(size_t books);
+    static int scan(size_t books);
+    static int fuzzy(size_t books);
+    static int suggest(size_t books);
+
+    // The search handler's original loop: std::string::find per field per
+    // book, with authors and genres matched once per distinct value
+    static vector<BookId> scanSubstring(const Library& library, const string& query);
+
+    // Fuzzy search the textbook way: a full dynamic-programming table per
+    // title and per distinct author and genre value, no pruning
+    static vector<FuzzyMatch> scanFuzzy(const Library& library, const string& query, size_t maxEdits);
+};
+
+vector<FuzzyMatch> Benchmarks::scanFuzzy(const Library& library, const string& query, size_t maxEdits) {
+    const Catalog& books = library.books;
+    vector<size_t> column(query.size() + 1);
+    auto distance = [&](string_view text) {
+        // column[i]: edits between query[0, i) and the best text suffix so far
+        for (size_t i = 0; i <= query.size(); ++i) column[i] = i;
+        size_t best = query.size();
+        for (char c : text) {
+            size_t diagonal = 0; // Row 0 is all zeros: a match may start anywhere
+            for (size_t i = 1; i <= query.size(); ++i) {
+                size_t up = column[i];
+                column[i] = min({column[i] + 1, column[i - 1] + 1, diagonal + (query[i - 1] != c)});
+                diagonal = up;
             }
+            best = min(best, column[query.size()]);
         }
-        return false;
+        return best;
+    };
+    vector<size_t> best(books.size(), maxEdits + 1);
+    for (BookId id = 0; id < books.size(); ++id) best[id] = distance(books.getFoldedTitle(id));
+    for (Symbol code = 0; code < library.authorFieldIndex.size(); ++code) {
+        size_t d = distance(books.getFoldedAuthorValue(code));
+        for (BookId id : library.authorFieldIndex[code]) best[id] = min(best[id], d);
     }
-
-    void displayDetails() const {
-        cout << "User ID: " << userId << "\n"
-             << "Name: " << name << "\n"
-             << "Email: " << email << "\n"
-             << "Books Borrowed: " << borrowedBooks.size() << "\n";
+    for (Symbol code = 0; code < library.genreIndex.size(); ++code) {
+        size_t d = distance(books.getFoldedGenreValue(code));
+        for (BookId id : library.genreIndex[code]) best[id] = min(best[id], d);
+    }
+    vector<FuzzyMatch> matches;
+    for (size_t d = 0; d <= maxEdits; ++d) {
+        for (BookId id = 0; id < books.size(); ++id) {
+            if (best[id] == d) matches.push_back({id, static_cast<uint32_t>(d)});
+        }
     }
+    return matches;
+}
 
-    void displayBorrowedBooks() const {
-        if (borrowedBooks.empty()) {
-            cout << "No books currently borrowed.\n";
-            return;
+vector<BookId> Benchmarks::scanSubstring(const Library& library, const string& query) {
+    const Catalog& books = library.books;
+    auto matchingCodes = [&query](const SymbolTable& values) {
+        vector<uint8_t> matches(values.size());
+        for (Symbol code = 0; code < values.size(); ++code) {
+            matches[code] = values.get(code).find(query) != string::npos;
         }
+        return matches;
+    };
+    vector<uint8_t> authorMatches = matchingCodes(books.getAuthorValues());
+    vector<uint8_t> genreMatches = matchingCodes(books.getGenreValues());
 
-        cout << "Borrowed Books:\n";
-        for (const auto& entry : borrowedBooks) {
-            time_t dueDate = entry.second;
-            tm* tmDueDate = localtime(&dueDate);
-            cout << "- " << entry.first->getTitle() 
-                 << " (Due: " << put_time(tmDueDate, "%Y-%m-%d") << ")\n";
+    vector<BookId> results;
+    for (BookId id = 0; id < books.size(); ++id) {
+        if (authorMatches[books.getAuthorCode(id)] || genreMatches[books.getGenreCode(id)] ||
+            books.getTitle(id).find(query) != string::npos) {
+            results.push_back(id);
         }
     }
-};
-
-// Library class (Singleton)
-class Library {
+    return results;
+}
 
-    httplib::Server svr;  // Add this as a private member variable
-    bool serverRunning = false;
-    static Library* instance;
-    vector<Book*> books;
-    vector<User*> users;
+// Text loader: legacy getline/stringstream parse vs RecordReader, single
+// thread and chunked across cores, over a generated [BOOKS] file
+int Benchmarks::load(size_t lines) {
+    const string path = "bench_library_data.txt";
+    {
+        ofstream out(path, ios::trunc);
+        for (size_t i = 0; i < lines; ++i) {
+            out << "Title " << i << ",Author " << i % 5000 << ",978" << setw(10) << setfill('0') << i
+                << setfill(' ') << ",Genre " << i % 40 << "," << 1900 + i % 120 << "," << i % 2 << "\n";
+        }
+    }
+    cout << "Parsing " << lines << " book rows\n";
 
-    // Private constructor for singleton
-    Library() {
-        loadData();
+    // Every leg fills a fresh vector, so none reuses another's capacity
+    auto start = chrono::steady_clock::now();
+    {
+        vector<BookRecord> books;
+        ifstream in(path);
+        string line;
+        while (getline(in, line)) books.push_back(legacyParseBook(line));
+        reportBenchmark("stringstream", books.size(), elapsedMs(start));
     }
 
-public:
+    MappedFile file;
+    if (!file.open(path)) {
+        cerr << "Could not map " << path << "\n";
+        return 1;
+    }
+    string_view text(file.getData(), file.getSize());
 
-     void startServer() {
-        if (serverRunning) return;
-        
-        // Enable CORS
-        svr.set_default_headers({
-            {"Access-Control-Allow-Origin", "*"},
-            {"Access-Control-Allow-Methods", "GET, POST, OPTIONS"},
-            {"Access-Control-Allow-Headers", "Content-Type"}
-        });
+    start = chrono::steady_clock::now();
+    {
+        vector<BookRecord> books;
+        for (string_view rest = text; !rest.empty();) {
+            size_t eol = rest.find('\n');
+            BookRecord book;
+            if (Library::parseBook(rest.substr(0, eol), book)) books.push_back(move(book));
+            rest.remove_prefix(eol == string_view::npos ? rest.size() : eol + 1);
+        }
+        reportBenchmark("RecordReader", books.size(), elapsedMs(start));
+    }
 
-        // Get all books
-        svr.Get("/api/books", [this](const auto& req, auto& res) {
-            json books_json;
-            for (auto book : books) {
-                books_json.push_back({
-                    {"title", book->getTitle()},
-                    {"author", book->getAuthor()},
-                    {"isbn", book->getIsbn()},
-                    {"genre", book->getGenre()},
-                    {"year", book->getPublicationYear()},
-                    {"available", book->isAvailable()}
-                });
-            }
-            res.set_content(books_json.dump(), "application/json");
+    start = chrono::steady_clock::now();
+    {
+        size_t threads = max(1u, thread::hardware_concurrency());
+        vector<BookRecord> books = parseLinesParallel<BookRecord>(text, threads, [](string_view line, vector<BookRecord>& out) {
+            BookRecord book;
+            if (Library::parseBook(line, book)) out.push_back(move(book));
         });
+        reportBenchmark("RecordReader, all cores", books.size(), elapsedMs(start));
+    }
 
-        // Search books
-        svr.Get("/api/books/search", [this](const auto& req, auto& res) {
-            string query = req.get_param_value("q");
-            vector<Book*> results;
-            
-            // Search in title, author, and genre
-            for (auto book : books) {
-                if (book->getTitle().find(query) != string::npos ||
-                    book->getAuthor().find(query) != string::npos ||
-                    book->getGenre().find(query) != string::npos) {
-                    results.push_back(book);
-                }
-            }
-            
-            json response;
-            for (auto book : results) {
-                response.push_back({
-                    {"title", book->getTitle()},
-                    {"author", book->getAuthor()},
-                    {"isbn", book->getIsbn()},
-                    {"available", book->isAvailable()}
-                });
-            }
-            res.set_content(response.dump(), "application/json");
-        });
+    file.close();
+    remove(path.c_str());
+    return 0;
+}
 
-        // User login
-        svr.Post("/api/login", [this](const auto& req, auto& res) {
-            auto body = json::parse(req.body);
-            string email = body["email"];
-            User* user = findUserByEmail(email);
-            
-            if (user) {
-                res.set_content(json{
-                    {"success", true},
-                    {"name", user->getName()},
-                    {"email", user->getEmail()},
-                    {"userId", user->getUserId()}
-                }.dump(), "application/json");
-            } else {
-                res.set_content(json{{"success", false}}.dump(), "application/json");
-            }
-        });
+// Login (email lookup) and registration checks (ID and email misses) as
+// the user count grows, against the linear scans the indexes replaced
+int Benchmarks::lookups(size_t maxUsers) {
+    const size_t probes = 100000;
+    Library library{Library::InMemory{}};
+    size_t users = 0;
 
-        serverRunning = true;
-        std::thread server_thread([this]() {
-            std::cout << "Server running on http://localhost:8080\n";
-            svr.listen("localhost", 8080);
-        });
-        server_thread.detach();
-    }
+    cout << left << setw(12) << "users" << right << setw(16) << "login ns/op"
+         << setw(16) << "register ns/op" << setw(16) << "scan ns/op" << "\n";
+    for (size_t target = 1000; target <= maxUsers; target *= 10) {
+        for (; users < target; ++users) {
+            string id = "user" + to_string(users);
+            library.insertUser(id, "Name " + to_string(users), id + "@example.com");
+        }
 
-    void stopServer() {
-        if (serverRunning) {
-            svr.stop();
-            serverRunning = false;
+        size_t found = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < probes; ++i) {
+            size_t n = (i * 7919) % users;
+            found += library.findUserByEmail("user" + to_string(n) + "@example.com") != nullptr;
         }
-    }
+        double loginNs = elapsedMs(start) * 1e6 / probes;
 
-    // Delete copy constructor and assignment operator
-    Library(const Library&) = delete;
-    Library& operator=(const Library&) = delete;
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < probes; ++i) {
+            string id = "new" + to_string(i);
+            found += library.findUserById(id) != nullptr;
+            found += library.findUserByEmail(id + "@example.com") != nullptr;
+        }
+        double registerNs = elapsedMs(start) * 1e6 / probes;
 
-    static Library* getInstance() {
-        if (!instance) {
-            instance = new Library();
+        // The old findUserByEmail; fewer probes since each one is O(users)
+        size_t scanProbes = max<size_t>(10, probes * 1000 / users / 10);
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < scanProbes; ++i) {
+            string email = "user" + to_string((i * 7919) % users) + "@example.com";
+            for (auto user : library.users) {
+                if (user->getEmail() == email) {
+                    ++found;
+                    break;
+                }
+            }
         }
-        return instance;
+        double scanNs = elapsedMs(start) * 1e6 / scanProbes;
+
+        cout << left << setw(12) << users << right << fixed << setprecision(0)
+             << setw(16) << loginNs << setw(16) << registerNs << setw(16) << scanNs << "\n";
+        if (found == 0) cout << "(no hits)\n"; // Keeps the lookups observable
     }
+    return 0;
+}
+
+// User load and teardown: one new/delete per user vs the pool
+int Benchmarks::users(size_t count) {
+    vector<array<string, 3>> rows(count);
+    for (size_t i = 0; i < count; ++i) {
+        string id = "user" + to_string(i);
+        rows[i] = {id, "Name " + to_string(i), id + "@example.com"};
+    }
+    cout << "Creating and freeing " << count << " users\n";
 
-    ~Library() {
-        for (auto book : books) delete book;
+    {
+        vector<User*> users;
+        users.reserve(count);
+        auto start = chrono::steady_clock::now();
+        for (const auto& row : rows) users.push_back(new User(row[0], row[1], row[2]));
+        reportBenchmark("new, load", count, elapsedMs(start));
+        start = chrono::steady_clock::now();
         for (auto user : users) delete user;
+        reportBenchmark("new, teardown", count, elapsedMs(start));
+    }
+    {
+        auto pool = make_unique<ObjectPool<User>>();
+        vector<User*> users;
+        users.reserve(count);
+        auto start = chrono::steady_clock::now();
+        for (const auto& row : rows) users.push_back(pool->create(row[0], row[1], row[2]));
+        reportBenchmark("pool, load", count, elapsedMs(start));
+        start = chrono::steady_clock::now();
+        pool.reset();
+        reportBenchmark("pool, teardown", count, elapsedMs(start));
     }
+    return 0;
+}
 
-    void addBook(Book* book) {
-        books.push_back(book);
-        saveData();
+// Availability queries: per-book checks vs the bitmap's popcount, word-wide
+// AND with a genre bitmap, and select()
+int Benchmarks::availability(size_t bookCount) {
+    Library library{Library::InMemory{}};
+    library.books.reserve(bookCount);
+    for (size_t i = 0; i < bookCount; ++i) {
+        library.insertBook(BookRecord{"T" + to_string(i), "A", to_string(i), "Genre " + to_string(i % 8),
+                                      2000, (i * 2654435761u) % 3 != 0, {}});
     }
+    const Catalog& books = library.books;
+    Symbol genre = books.getGenreValues().find("Genre 3");
+    cout << "Querying availability over " << bookCount << " books\n";
+    const int rounds = 10;
 
-    void addUser(User* user) {
-        users.push_back(user);
-        saveData();
+    size_t scanned = 0;
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (BookId id = 0; id < books.size(); ++id) scanned += books.isAvailable(id);
     }
+    reportBenchmark("count, per book", bookCount * rounds, elapsedMs(start));
+    size_t counted = 0;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) counted += library.countAvailable();
+    reportBenchmark("count, popcount", bookCount * rounds, elapsedMs(start));
 
-    Book* findBookByTitle(const string& title) {
-        // Linear search
-        for (auto book : books) {
-            if (book->getTitle() == title) {
-                return book;
-            }
-        }
-        return nullptr;
+    size_t genreScanned = 0;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (BookId id : library.genreIndex[genre]) genreScanned += books.isAvailable(id);
     }
+    reportBenchmark("genre count, postings", bookCount * rounds, elapsedMs(start));
+    size_t genreCounted = 0;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) genreCounted += library.countAvailableInGenre(genre);
+    reportBenchmark("genre count, bitmap AND", bookCount * rounds, elapsedMs(start));
 
-    vector<Book*> findBooksByAuthor(const string& author) {
-        vector<Book*> result;
-        for (auto book : books) {
-            if (book->getAuthor() == author) {
-                result.push_back(book);
+    // The page of 20 available books starting halfway through
+    size_t offset = counted / rounds / 2;
+    BookId scanFirst = 0;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        size_t skipped = 0;
+        for (BookId id = 0; id < books.size(); ++id) {
+            if (books.isAvailable(id) && skipped++ == offset) {
+                scanFirst = id;
+                break;
             }
         }
-        return result;
     }
+    reportBenchmark("page, scan", bookCount * rounds, elapsedMs(start));
+    vector<BookId> page;
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) page = library.findAvailableBooks(SymbolTable::kMissing, offset, 20);
+    reportBenchmark("page, select", bookCount * rounds, elapsedMs(start));
 
-    vector<Book*> findBooksByGenre(const string& genre) {
-        vector<Book*> result;
-        // First sort books by genre for binary search
-        sort(books.begin(), books.end(), [](Book* a, Book* b) {
-            return a->getGenre() < b->getGenre();
-        });
-
-        // Binary search implementation
-        auto low = lower_bound(books.begin(), books.end(), genre, 
-            [](Book* book, const string& genre) {
-                return book->getGenre() < genre;
-            });
-
-        auto high = upper_bound(books.begin(), books.end(), genre, 
-            [](const string& genre, Book* book) {
-                return genre < book->getGenre();
-            });
+    if (scanned != counted || genreScanned != genreCounted || page.empty() || page[0] != scanFirst ||
+        books.getAvailability().rank(scanFirst) != offset) {
+        cerr << "Availability results differ\n";
+        return 1;
+    }
+    return 0;
+}
 
-        for (auto it = low; it != high; ++it) {
-            result.push_back(*it);
+// Title scan over a books-only catalog vs one where three quarters of the
+// items are DVDs, periodicals and e-books
+int Benchmarks::items(size_t count) {
+    cout << "Scanning titles of " << count << " items\n";
+    for (bool mixed : {false, true}) {
+        Library library{Library::InMemory{}};
+        library.books.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            BookRecord item{"Title " + to_string(i), "Author", to_string(i), "Genre", 2000, true, {}};
+            if (mixed) {
+                switch (i % 4) {
+                    case 1: item.details = DvdInfo{90}; break;
+                    case 2: item.details = PeriodicalInfo{static_cast<int32_t>(i)}; break;
+                    case 3: item.details = EBookInfo{"EPUB"}; break;
+                }
+            }
+            library.insertBook(item);
         }
+        const Catalog& books = library.books;
+        size_t matches = 0;
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < 5; ++r) {
+            for (BookId id = 0; id < books.size(); ++id) matches += books.getTitle(id).find("99") != string_view::npos;
+        }
+        reportBenchmark(mixed ? "mixed items" : "books only", count * 5, elapsedMs(start));
+        if (matches == 0) return 1;
+    }
+    return 0;
+}
 
-        return result;
+// A year of daily overdue checks over loans due across that year: scanning
+// every loan each day vs advancing the timing wheel one day
+int Benchmarks::overdueScan(size_t loanCount) {
+    const Day start = 20000;
+    const int days = 365;
+    vector<Day> dues(loanCount);
+    OverdueScheduler scheduler(start);
+    for (size_t i = 0; i < loanCount; ++i) {
+        dues[i] = start + static_cast<Day>((i * 7919) % days);
+        scheduler.schedule({static_cast<LoanId>(i), 0, dues[i]});
     }
+    cout << "Daily overdue checks for " << days << " days over " << loanCount << " loans\n";
 
-    User* findUserById(const string& userId) {
-        for (auto user : users) {
-            if (user->getUserId() == userId) {
-                return user;
-            }
-        }
-        return nullptr;
+    size_t scanned = 0;
+    auto start_time = chrono::steady_clock::now();
+    for (Day day = start + 1; day <= start + days; ++day) {
+        for (Day due : dues) scanned += due == day - 1; // Became overdue today
     }
+    reportBenchmark("scan all loans", loanCount * days, elapsedMs(start_time));
 
-    User* findUserByEmail(const string& email) {
-        for (auto user : users) {
-            if (user->getEmail() == email) {
-                return user;
-            }
-        }
-        return nullptr;
+    size_t expired = 0;
+    start_time = chrono::steady_clock::now();
+    for (Day day = start + 1; day <= start + days; ++day) {
+        expired += scheduler.advance(day, [](const OverdueScheduler::Entry&) { return true; }).size();
     }
+    reportBenchmark("timing wheel", loanCount * days, elapsedMs(start_time));
 
-    void displayAllBooks() {
-        // Bubble sort by title
-        for (size_t i = 0; i < books.size(); ++i) {
-            for (size_t j = 0; j < books.size() - i - 1; ++j) {
-                if (books[j]->getTitle() > books[j+1]->getTitle()) {
-                    swap(books[j], books[j+1]);
-                }
-            }
-        }
+    if (scanned != loanCount || expired != loanCount) {
+        cerr << "Overdue results differ\n";
+        return 1;
+    }
+    return 0;
+}
 
-        cout << "\n===== All Books =====\n";
-        for (auto book : books) {
-            book->displayDetails();
-            cout << "--------------------\n";
-        }
+void Benchmarks::fillSearchCatalog(Library& library, size_t bookCount) {
+    const size_t vocabulary = 20000;
+    library.books.reserve(bookCount);
+    for (size_t i = 0; i < bookCount; ++i) {
+        // Zipf-like word choice: low ranks are common
+        size_t a = (i * 7919) % vocabulary, b = (i * 104729) % 200, c = (i * 31) % 20;
+        library.insertBook(BookRecord{benchWord(a) + " " + benchWord(b) + " " + benchWord(c),
+                                      "Author " + to_string(i % 5000), to_string(i), "Genre " + to_string(i % 40),
+                                      2000, true, {}});
     }
+}
 
-    void saveData() {
-        ofstream outFile("library_data.txt");
-        if (!outFile) {
-            cerr << "Error saving data to file.\n";
-            return;
-        }
+// Catalog of generated titles: the substring scan vs the term index
+int Benchmarks::search(size_t bookCount) {
+    Library library{Library::InMemory{}};
+    auto start = chrono::steady_clock::now();
+    fillSearchCatalog(library, bookCount);
+    reportBenchmark("build catalog + index", bookCount, elapsedMs(start));
+    cout << library.termIndex.size() << " terms, " << library.termIndex.byteSize() / 1024
+         << " KiB of term postings, " << library.titleTrigrams.byteSize() / 1024 << " KiB of title trigrams\n";
 
-        // Save books
-        outFile << "[BOOKS]\n";
-        for (auto book : books) {
-            outFile << book->getTitle() << ","
-                   << book->getAuthor() << ","
-                   << book->getIsbn() << ","
-                   << book->getGenre() << ","
-                   << book->getPublicationYear() << ","
-                   << book->isAvailable() << "\n";
+    struct Query {
+        string text;
+        bool matchAll;
+    };
+    vector<Query> queries = {{benchWord(1234), true}, {benchWord(7) + " " + benchWord(3), true},
+                             {benchWord(1234) + " " + benchWord(3), true}, {benchWord(1234) + " " + benchWord(4321), false}};
+    cout << left << setw(32) << "query" << right << setw(12) << "results" << setw(14) << "scan ms"
+         << setw(14) << "index ms" << "\n";
+    const int rounds = 20;
+    for (const auto& query : queries) {
+        // The scan answers single-word queries; multi-word ones are run
+        // as one scan per word, combined the same way as the index
+        vector<BookId> scanned;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            vector<BookId> combined;
+            bool first = true;
+            TermIndex::tokenize(query.text, [&](string_view token) {
+                vector<BookId> hits = scanSubstring(library, string(token));
+                vector<BookId> next;
+                if (first) {
+                    next = hits;
+                } else if (query.matchAll) {
+                    set_intersection(combined.begin(), combined.end(), hits.begin(), hits.end(), back_inserter(next));
+                } else {
+                    set_union(combined.begin(), combined.end(), hits.begin(), hits.end(), back_inserter(next));
+                }
+                combined.swap(next);
+                first = false;
+            });
+            scanned = combined;
         }
+        double scanMs = elapsedMs(start) / rounds;
 
-        // Save users
-        outFile << "[USERS]\n";
-        for (auto user : users) {
-            outFile << user->getUserId() << ","
-                   << user->getName() << ","
-                   << user->getEmail() << "\n";
+        vector<BookId> indexed;
+        start = chrono::steady_clock::now();
+        SearchMode mode = query.matchAll ? SearchMode::AllTerms : SearchMode::AnyTerm;
+        for (int r = 0; r < rounds; ++r) indexed = library.searchBooks(query.text, mode);
+        double indexMs = elapsedMs(start) / rounds;
 
-            // Save borrowed books
-            outFile << "[BORROWED]" << user->getUserId() << "\n";
-            for (const auto& entry : user->getBorrowedBooks()) {
-                outFile << entry.first->getIsbn() << ","
-                       << entry.second << "\n";
-            }
+        cout << left << setw(32) << (query.text + (query.matchAll ? " (and)" : " (or)")) << right
+             << setw(12) << indexed.size() << fixed << setprecision(3) << setw(14) << scanMs << setw(14)
+             << indexMs << "\n";
+        // None of these words occurs inside a longer one, so substring and
+        // word matching must agree
+        if (scanned != indexed) {
+            cerr << "Search results differ\n";
+            return 1;
         }
-
-        outFile.close();
     }
 
-    void loadData() {
-        ifstream inFile("library_data.txt");
-        if (!inFile) {
-            return; // No existing data file
+    // Default substring search: full scan vs trigram candidates + verify
+    cout << "\n" << left << setw(32) << "substring" << right << setw(12) << "results" << setw(14) << "scan ms"
+         << setw(14) << "trigram ms" << "\n";
+    for (string query : {benchWord(1234).substr(1, 4), benchWord(3) + " w", string("hor 123"), string("enre 3"), string("zzz")}) {
+        vector<BookId> scanned, indexed;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) scanned = scanSubstring(library, query);
+        double scanMs = elapsedMs(start) / rounds;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) indexed = library.searchBooks(query, SearchMode::Substring);
+        double indexMs = elapsedMs(start) / rounds;
+        cout << left << setw(32) << ("\"" + query + "\"") << right << setw(12) << indexed.size() << fixed
+             << setprecision(3) << setw(14) << scanMs << setw(14) << indexMs << "\n";
+        if (scanned != indexed) {
+            cerr << "Substring results differ\n";
+            return 1;
         }
+    }
+    return 0;
+}
 
-        string line;
-        string section;
-        User* currentUser = nullptr;
-
-        while (getline(inFile, line)) {
-            if (line.empty()) continue;
+// Short-query fallback: the find-per-book loop vs each scan kernel over
+// the folded title arena, titles only
+int Benchmarks::scan(size_t bookCount) {
+    Library library{Library::InMemory{}};
+    library.books.reserve(bookCount);
+    for (size_t i = 0; i < bookCount; ++i) {
+        library.insertBook(BookRecord{"Title " + to_string(i * 2654435761u % 100000007) + " of the series",
+                                      "Author", to_string(i), "Genre", 2000, true, {}});
+    }
+    const Catalog& books = library.books;
+    vector<FindKernelInfo> kernels = availableFindKernels();
+    cout << "Scanning " << bookCount << " titles\n" << left << setw(12) << "query" << right << setw(10)
+         << "results" << setw(12) << "find loop";
+    for (const auto& kernel : kernels) cout << setw(12) << kernel.name;
+    cout << "  (ms per query)\n";
 
-            if (line[0] == '[') {
-                section = line;
-                continue;
+    const int rounds = 5;
+    for (string query : {"x", "q", "12", "s ", "9999", "the series"}) {
+        vector<BookId> expected;
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            expected.clear();
+            for (BookId id = 0; id < books.size(); ++id) {
+                if (books.getFoldedTitle(id).find(query) != string_view::npos) expected.push_back(id);
             }
-
-            if (section == "[BOOKS]") {
-                stringstream ss(line);
-                string title, author, isbn, genre, availableStr;
-                int publicationYear;
-                bool available;
-
-                getline(ss, title, ',');
-                getline(ss, author, ',');
-                getline(ss, isbn, ',');
-                getline(ss, genre, ',');
-                ss >> publicationYear;
-                ss.ignore(); // Ignore comma
-                ss >> available;
-
-                Book* book = new Book(title, author, isbn, genre, publicationYear);
-                book->setAvailable(available);
-                books.push_back(book);
-            }
-            else if (section == "[USERS]") {
-                stringstream ss(line);
-                string userId, name, email;
-                getline(ss, userId, ',');
-                getline(ss, name, ',');
-                getline(ss, email, ',');
-
-                User* user = new User(userId, name, email);
-                users.push_back(user);
-                currentUser = user;
-            }
-            else if (section.find("[BORROWED]") != string::npos) {
-                if (!currentUser) continue;
-
-                stringstream ss(line);
-                string isbn;
-                time_t dueDate;
-                getline(ss, isbn, ',');
-                ss >> dueDate;
-
-                Book* book = findBookByIsbn(isbn);
-                if (book) {
-                    currentUser->borrowBook(book);
-                    // Set the due date (since borrowBook creates a new entry)
-                    if (!currentUser->getBorrowedBooks().empty()) {
-                        const_cast<pair<Book*, time_t>&>(currentUser->getBorrowedBooks().back()).second = dueDate;
-                    }
-                }
+        }
+        cout << left << setw(12) << ("\"" + query + "\"") << right << setw(10) << expected.size() << fixed
+             << setprecision(2) << setw(12) << elapsedMs(start) / rounds;
+        for (const auto& kernel : kernels) {
+            vector<BookId> found;
+            start = chrono::steady_clock::now();
+            for (int r = 0; r < rounds; ++r) found = books.findInTitles(query, kernel.find);
+            cout << setw(12) << elapsedMs(start) / rounds;
+            if (found != expected) {
+                cerr << "\n" << kernel.name << " results differ\n";
+                return 1;
             }
         }
+        cout << "\n";
+    }
+    return 0;
+}
+
+// Fuzzy search over misspelled queries: the textbook DP table per field vs
+// the bit-parallel kernel with trigram pruning
+int Benchmarks::fuzzy(size_t bookCount) {
+    Library library{Library::InMemory{}};
+    fillSearchCatalog(library, bookCount);
 
-        inFile.close();
+    struct Query {
+        string text;
+        size_t maxEdits;
+    };
+    // Typos in real titles: a transposition, a dropped and a doubled byte
+    string title = string(library.books.getTitle(123456));
+    string swapped = title, dropped = title.substr(0, 4) + title.substr(5), doubled = title + title.back();
+    swap(swapped[2], swapped[3]);
+    vector<Query> queries = {{swapped, 2}, {dropped, 1}, {doubled, 2}, {"athor 4999", 1},
+                             {"genr 17", 1}, {"w902358", 2}, {"w9o", 1}};
+    cout << "Fuzzy search over " << bookCount << " books\n" << left << setw(28) << "query" << right
+         << setw(8) << "edits" << setw(10) << "results" << setw(12) << "DP ms" << setw(12) << "fuzzy ms\n";
+    const int rounds = 3;
+    for (const auto& query : queries) {
+        vector<FuzzyMatch> expected, found;
+        auto start = chrono::steady_clock::now();
+        expected = scanFuzzy(library, query.text, query.maxEdits);
+        double scanMs = elapsedMs(start);
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) found = library.searchFuzzy(query.text, query.maxEdits);
+        double fuzzyMs = elapsedMs(start) / rounds;
+        cout << left << setw(28) << ("\"" + query.text + "\"") << right << setw(8) << query.maxEdits << setw(10)
+             << found.size() << fixed << setprecision(3) << setw(12) << scanMs << setw(12) << fuzzyMs << "\n";
+        bool same = expected.size() == found.size();
+        for (size_t i = 0; same && i < found.size(); ++i) {
+            same = expected[i].id == found[i].id && expected[i].distance == found[i].distance;
+        }
+        if (!same) {
+            cerr << "Fuzzy results differ\n";
+            return 1;
+        }
     }
+    return 0;
+}
+
+// Autocomplete: index build and size, then top-8 completions from the
+// index vs sorting every matching key
+int Benchmarks::suggest(size_t bookCount) {
+    Library library{Library::InMemory{}};
+    fillSearchCatalog(library, bookCount);
+    vector<string> foldedNames;
+    vector<SuggestIndex::Key> keys = library.collectSuggestKeys(foldedNames);
+    size_t keyBytes = 0;
+    for (const auto& key : keys) keyBytes += key.text.size();
+    auto start = chrono::steady_clock::now();
+    SuggestIndex index(keys);
+    reportBenchmark("build suggest index", keys.size(), elapsedMs(start));
+    cout << index.size() << " distinct keys, " << keyBytes / 1024 << " KiB of key text, index "
+         << index.byteSize() / 1024 << " KiB\n";
 
-    Book* findBookByIsbn(const string& isbn) {
-        for (auto book : books) {
-            if (book->getIsbn() == isbn) {
-                return book;
+    const size_t k = 8;
+    cout << left << setw(16) << "prefix" << right << setw(10) << "matches" << setw(12) << "scan us" << setw(12)
+         << "index us\n";
+    for (string prefix : {"w", "w9", "w902385 w", "auth", "author 49", "zz"}) {
+        // Baseline: every key with the prefix, merged and sorted by weight
+        const int scanRounds = 3, rounds = 10000;
+        vector<SuggestIndex::Suggestion> expected;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < scanRounds; ++r) {
+            map<string_view, SuggestIndex::Suggestion> matching; // Key -> smallest ref, total weight
+            for (const auto& key : keys) {
+                if (key.text.substr(0, prefix.size()) != prefix) continue;
+                auto it = matching.emplace(key.text, SuggestIndex::Suggestion{key.ref, 0}).first;
+                it->second.ref = min(it->second.ref, key.ref);
+                it->second.weight += key.weight;
             }
+            expected.clear();
+            for (const auto& entry : matching) expected.push_back(entry.second);
+            stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.weight > b.weight; });
+            if (expected.size() > k) expected.resize(k);
         }
-        return nullptr;
-    }
+        double scanUs = elapsedMs(start) * 1000 / scanRounds;
 
-    const vector<Book*>& getAllBooks() const { return books; }
-    const vector<User*>& getAllUsers() const { return users; }
-};
+        vector<SuggestIndex::Suggestion> found;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) found = index.complete(prefix, k);
+        double indexUs = elapsedMs(start) * 1000 / rounds;
 
-// Initialize static member
-Library* Library::instance = nullptr;
+        size_t matches = 0;
+        for (const auto& key : keys) matches += key.text.substr(0, prefix.size()) == prefix;
+        cout << left << setw(16) << ("\"" + prefix + "\"") << right << setw(10) << matches << fixed
+             << setprecision(2) << setw(12) << scanUs << setw(12) << indexUs << "\n";
+        bool same = found.size() == expected.size();
+        for (size_t i = 0; same && i < found.size(); ++i) {
+            same = found[i].ref == expected[i].ref && found[i].weight == expected[i].weight;
+        }
+        if (!same) {
+            cerr << "Suggestions differ\n";
+            return 1;
+        }
+    }
+    return 0;
+}
 
 // Library Application class
 class LibraryApp {
@@ -538,7 +4659,8 @@ private:
         cout << "1. Search by Title\n";
         cout << "2. Search by Author\n";
         cout << "3. Search by Genre\n";
-        cout << "4. Back to Main Menu\n";
+        cout << "4. Search All Fields\n";
+        cout << "5. Back to Main Menu\n";
 
         int choice = getChoice();
         string query;
@@ -548,24 +4670,29 @@ private:
                 cout << "Enter book title: ";
                 getline(cin, query);
                 {
-                    Book* book = library->findBookByTitle(query);
+                    Book book = library->findBookByTitle(query);
                     if (book) {
                         cout << "\nBook Found:\n";
-                        book->displayDetails();
+                        book.displayDetails();
                     } else {
                         cout << "Book not found.\n";
+                        vector<Book> close = library->findBooksMatching(query, SearchMode::Fuzzy);
+                        if (!close.empty()) cout << "Did you mean:\n";
+                        for (size_t i = 0; i < close.size() && i < 5; ++i) {
+                            cout << "  " << close[i].getTitle() << " by " << close[i].getAuthor() << "\n";
+                        }
                     }
                 }
                 break;
             case 2:
-                cout << "Enter author name: ";
+                cout << "Enter author name (separate co-authors with ';'): ";
                 getline(cin, query);
                 {
-                    vector<Book*> books = library->findBooksByAuthor(query);
+                    vector<Book> books = library->findBooksByAuthor(query);
                     if (!books.empty()) {
                         cout << "\nBooks by " << query << ":\n";
                         for (auto book : books) {
-                            book->displayDetails();
+                            book.displayDetails();
                             cout << "--------------------\n";
                         }
                     } else {
@@ -577,11 +4704,11 @@ private:
                 cout << "Enter genre: ";
                 getline(cin, query);
                 {
-                    vector<Book*> books = library->findBooksByGenre(query);
+                    vector<Book> books = library->findBooksByGenre(query);
                     if (!books.empty()) {
                         cout << "\nBooks in " << query << " genre:\n";
                         for (auto book : books) {
-                            book->displayDetails();
+                            book.displayDetails();
                             cout << "--------------------\n";
                         }
                     } else {
@@ -590,6 +4717,22 @@ private:
                 }
                 break;
             case 4:
+                cout << "Enter text to find in title, author or genre: ";
+                getline(cin, query);
+                {
+                    vector<Book> books = library->findBooksMatching(query, SearchMode::Substring);
+                    if (!books.empty()) {
+                        cout << "\n" << books.size() << " book(s) matching \"" << query << "\":\n";
+                        for (auto book : books) {
+                            book.displayDetails();
+                            cout << "--------------------\n";
+                        }
+                    } else {
+                        cout << "No matching books found.\n";
+                    }
+                }
+                break;
+            case 5:
                 return;
             default:
                 cout << "Invalid choice.\n";
@@ -617,8 +4760,16 @@ private:
             return;
         }
 
-        User* newUser = new User(userId, name, email);
-        library->addUser(newUser);
+        switch (library->registerUser(userId, name, email)) {
+            case Library::RegisterResult::Registered:
+                break;
+            case Library::RegisterResult::NotSaved:
+                cout << "Registration could not be saved.\n";
+                return;
+            default:
+                cout << "User ID or email already registered.\n";
+                return;
+        }
         cout << "Registration successful! You can now login.\n";
     }
 
@@ -650,23 +4801,21 @@ private:
         cout << "Enter the title of the book you want to borrow: ";
         getline(cin, title);
 
-        Book* book = library->findBookByTitle(title);
+        Book book = library->findBookByTitle(title);
         if (!book) {
             cout << "Book not found.\n";
             return;
         }
 
-        if (!book->isAvailable()) {
+        if (!book.isAvailable()) {
             cout << "This book is currently not available.\n";
             return;
         }
 
-        if (currentUser->borrowBook(book)) {
-            library->saveData();
-            time_t dueDate = time(nullptr) + 14 * 24 * 60 * 60;
-            tm* tmDueDate = localtime(&dueDate);
-            cout << "You have successfully borrowed '" << book->getTitle() 
-                 << "'. Due date: " << put_time(tmDueDate, "%Y-%m-%d") << "\n";
+        LoanInfo loan;
+        if (library->borrowBook(currentUser, book) && library->findLoan(book, loan)) {
+            cout << "You have successfully borrowed '" << book.getTitle() 
+                 << "'. Due date: " << formatDay(loan.due) << "\n";
         } else {
             cout << "Failed to borrow the book.\n";
         }
@@ -674,7 +4823,7 @@ private:
 
     void returnBook() {
         cout << "\n===== Return a Book =====\n";
-        const auto& borrowedBooks = currentUser->getBorrowedBooks();
+        vector<LoanInfo> borrowedBooks = library->getLoans(currentUser);
         if (borrowedBooks.empty()) {
             cout << "You have no books to return.\n";
             return;
@@ -682,10 +4831,8 @@ private:
 
         cout << "Your borrowed books:\n";
         for (size_t i = 0; i < borrowedBooks.size(); ++i) {
-            time_t dueDate = borrowedBooks[i].second;
-            tm* tmDueDate = localtime(&dueDate);
-            cout << i+1 << ". " << borrowedBooks[i].first->getTitle()
-                 << " (Due: " << put_time(tmDueDate, "%Y-%m-%d") << ")\n";
+            cout << i+1 << ". " << borrowedBooks[i].book.getTitle()
+                 << " (Due: " << formatDay(borrowedBooks[i].due) << ")\n";
         }
 
         cout << "Enter the number of the book you want to return: ";
@@ -694,10 +4841,9 @@ private:
         cin.ignore();
 
         if (choice > 0 && choice <= borrowedBooks.size()) {
-            Book* book = borrowedBooks[choice-1].first;
-            if (currentUser->returnBook(book)) {
-                library->saveData();
-                cout << "You have successfully returned '" << book->getTitle() << "'.\n";
+            Book book = borrowedBooks[choice-1].book;
+            if (library->returnBook(currentUser, book)) {
+                cout << "You have successfully returned '" << book.getTitle() << "'.\n";
             } else {
                 cout << "Failed to return the book.\n";
             }
@@ -709,16 +4855,72 @@ private:
     void viewAccount() {
         cout << "\n===== My Account =====\n";
         currentUser->displayDetails();
-        currentUser->displayBorrowedBooks();
+
+        vector<LoanInfo> borrowedBooks = library->getLoans(currentUser);
+        if (borrowedBooks.empty()) {
+            cout << "No books currently borrowed.\n";
+            return;
+        }
+
+        cout << "Borrowed Books:\n";
+        for (const auto& loan : borrowedBooks) {
+            cout << "- " << loan.book.getTitle() << " (Due: " << formatDay(loan.due)
+                 << (loan.due < today() ? ", overdue" : "") << ")\n";
+        }
     }
 };
 
 
 int main(int argc, char* argv[]) {
-    // Check for --server argument
-    bool runAsServer = (argc > 1 && std::string(argv[1]) == "--server");
+    bool runAsServer = false;
+    SnapshotPolicy snapshotPolicy;
+    GroupCommitPolicy commitPolicy;
+    chrono::seconds overdueInterval{60};
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--server") {
+            runAsServer = true;
+        } else if (arg == "--bench" && hasValue) {
+            string name = argv[++i];
+            size_t size = i + 1 < argc ? stoull(argv[i + 1]) : 0;
+            return Benchmarks::run(name, size);
+        } else if (arg == "--snapshot-bytes" && hasValue) {
+            snapshotPolicy.maxLogBytes = stoull(argv[++i]);
+        } else if (arg == "--snapshot-records" && hasValue) {
+            snapshotPolicy.maxLogRecords = stoull(argv[++i]);
+        } else if (arg == "--snapshot-interval" && hasValue) {
+            snapshotPolicy.interval = chrono::seconds(stoll(argv[++i]));
+        } else if (arg == "--snapshot-debounce-ms" && hasValue) {
+            snapshotPolicy.debounce = chrono::milliseconds(stoll(argv[++i]));
+        } else if (arg == "--overdue-interval" && hasValue) {
+            overdueInterval = chrono::seconds(stoll(argv[++i]));
+        } else if (arg == "--commit-batch" && hasValue) {
+            commitPolicy.maxBatchRecords = stoull(argv[++i]);
+        } else if (arg == "--commit-wait-us" && hasValue) {
+            commitPolicy.maxWait = chrono::microseconds(stoll(argv[++i]));
+        } else if (arg == "--snapshot-format" && hasValue) {
+            string format = argv[++i];
+            if (format != "text" && format != "binary") {
+                cerr << "Snapshot format must be text or binary\n";
+                return 1;
+            }
+            snapshotPolicy.format = format == "text" ? SnapshotFormat::Text : SnapshotFormat::Binary;
+        } else {
+            cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    Library::getInstance()->setSnapshotPolicy(snapshotPolicy);
+    Library::getInstance()->setGroupCommitPolicy(commitPolicy);
+    Library::getInstance()->setOverdueInterval(overdueInterval);
 
     if (runAsServer) {
+        Library::getInstance()->setOverdueHandler([](const vector<LoanInfo>& batch) {
+            cout << batch.size() << " loan(s) became overdue\n";
+        });
         Library::getInstance()->startServer();
         
         // Keep the server running
@@ -731,5 +4933,15 @@ int main(int argc, char* argv[]) {
         app.run();
     }
 
+    // Fold the mutation log into a fresh snapshot on clean exit; the
+    // totals then include the final flush
+    Library::getInstance()->shutdown();
+    GroupCommitStats stats = Library::getInstance()->getGroupCommitStats();
+    if (runAsServer && stats.batches) {
+        cout << "Log commits: " << stats.records << " records in " << stats.batches
+             << " batches, avg flush " << fixed << setprecision(2)
+             << stats.totalFlushMs / stats.batches << " ms\n";
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -9,8 +9,14 @@ document.addEventListener('DOMContentLoaded', () => {
     const searchBtn = document.getElementById('search-btn');
     const userStatus = document.getElementById('user-status');
     const emailInput = document.getElementById('email');
+    const searchInput = document.getElementById('search-input');
+    const suggestionList = document.getElementById('search-suggestions');
     
     let currentUser = null;
+    let suggestTimer = null;
+    let suggestRequest = 0; // Only the latest request's answer is shown
+
+    const API_BASE = 'http://localhost:8080';
 
     // Mock data - in real app this would come from backend
     const mockBooks = [
@@ -60,6 +66,15 @@ document.addEventListener('DOMContentLoaded', () => {
                 }, 500);
             });
         }
+
+        // Title and author completions from the C++ backend's
+        // /api/books/suggest; none if the server is unreachable
+        static suggest(prefix) {
+            const url = `${API_BASE}/api/books/suggest?q=${encodeURIComponent(prefix)}&limit=8`;
+            return fetch(url)
+                .then(response => response.ok ? response.json() : [])
+                .catch(() => []);
+        }
     }
 
     // Event listeners
@@ -73,8 +88,24 @@ document.addEventListener('DOMContentLoaded', () => {
         mainSection.classList.remove('hidden');
     });
 
+    searchInput.addEventListener('input', () => {
+        clearTimeout(suggestTimer);
+        const prefix = searchInput.value.trim();
+        if (!prefix) {
+            ++suggestRequest; // Drop any answer still in flight
+            suggestionList.innerHTML = '';
+            return;
+        }
+        // Wait for a pause in typing rather than asking on every keystroke
+        suggestTimer = setTimeout(async () => {
+            const request = ++suggestRequest;
+            const suggestions = await BackendService.suggest(prefix);
+            if (request === suggestRequest) displaySuggestions(suggestions);
+        }, 100);
+    });
+
     searchBtn.addEventListener('click', async () => {
-        const query = document.getElementById('search-input').value;
+        const query = searchInput.value;
         if (!query) return alert("Please enter search term");
         
         const results = await BackendService.searchBooks(query);
@@ -82,6 +113,16 @@ document.addEventListener('DOMContentLoaded', () => {
     });
 
     // Helper functions
+    function displaySuggestions(suggestions) {
+        suggestionList.innerHTML = '';
+        suggestions.forEach(suggestion => {
+            const option = document.createElement('option');
+            option.value = suggestion.text;
+            option.label = suggestion.kind === 'author' ? `Author (${suggestion.books} book${suggestion.books === 1 ? '' : 's'})` : 'Title';
+            suggestionList.appendChild(option);
+        });
+    }
+
     function displaySearchResults(books) {
         const resultsDiv = document.getElementById('search-results');
         resultsDiv.innerHTML = '';